@@ -1,76 +1,1743 @@
 #include <iostream>
 #include <string>
-#include <map>
 #include <vector>
 #include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <fstream>
+#include <string_view>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BANK_X86 1
+#endif
+
+// Money is kept as a whole number of cents so balances never pick up binary
+// rounding error.
+using Cents = int64_t;
+
+// Interest rates are in parts per million: 35000 is 3.5%.
+using RatePpm = int64_t;
+
+std::string formatCents(Cents amount) {
+    std::string sign = amount < 0 ? "-" : "";
+    uint64_t magnitude = amount < 0 ? 0 - static_cast<uint64_t>(amount) : static_cast<uint64_t>(amount);
+    std::string cents = std::to_string(magnitude % 100);
+    if (cents.size() < 2) cents = "0" + cents;
+    return sign + std::to_string(magnitude / 100) + "." + cents;
+}
+
+// Parses "12", "12.5" or "12.34" (an optional leading '$' is allowed).
+// Rejects more than two decimals rather than rounding the user's input.
+bool parseCents(const std::string& text, Cents& amount) {
+    size_t i = (!text.empty() && text[0] == '$') ? 1 : 0;
+    Cents whole = 0;
+    size_t digits = 0;
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i, ++digits) {
+        if (whole > (std::numeric_limits<Cents>::max() / 100 - 9) / 10) return false;
+        whole = whole * 10 + (text[i] - '0');
+    }
+    Cents fraction = 0;
+    size_t decimals = 0;
+    if (i < text.size() && text[i] == '.') {
+        for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i, ++decimals) {
+            if (decimals == 2) return false;
+            fraction = fraction * 10 + (text[i] - '0');
+        }
+    }
+    if (i != text.size() || digits + decimals == 0) return false;
+    if (decimals == 1) fraction *= 10;
+    amount = whole * 100 + fraction;
+    return true;
+}
+
+// product / 1e6 rounded to the nearest integer, ties to even.
+template <class Wide>
+Cents divideByMillionHalfEven(Wide product) {
+    const Wide scale = 1000000;
+    Wide quotient = product / scale;
+    Wide remainder = product % scale;
+    if (remainder < 0) {
+        remainder += scale;
+        quotient -= 1;
+    }
+    if (remainder * 2 > scale || (remainder * 2 == scale && (quotient & 1))) quotient += 1;
+    return static_cast<Cents>(quotient);
+}
+
+__extension__ typedef __int128 Int128; // GCC/Clang builtin; __extension__ keeps -Wpedantic quiet
+
+// amount * rate / 1e6, rounded to the nearest cent with ties to even so
+// repeated postings do not drift in either direction. Products that fit in
+// 64 bits (any balance under about $90 billion) avoid the slow 128-bit
+// division.
+Cents applyRate(Cents amount, RatePpm rate) {
+    int64_t product;
+    if (!__builtin_mul_overflow(amount, rate, &product)) return divideByMillionHalfEven(product);
+    return divideByMillionHalfEven(static_cast<Int128>(amount) * rate);
+}
+
+// Wall clock in microseconds. The coarse clock is a few nanoseconds to read
+// and its millisecond resolution is plenty for a transaction history.
+int64_t nowMicros() {
+    timespec ts;
+#ifdef CLOCK_REALTIME_COARSE
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+std::string formatTime(int64_t micros) {
+    std::time_t seconds = static_cast<std::time_t>(micros / 1000000);
+    std::tm local;
+    localtime_r(&seconds, &local);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return buffer;
+}
+
+// Local midnight at the start of a "YYYY-MM-DD" date, moved on by
+// extraDays, in microseconds.
+bool parseDate(const std::string& text, int64_t& micros, int extraDays = 0) {
+    std::tm local = {};
+    char extra;
+    if (std::sscanf(text.c_str(), "%d-%d-%d%c", &local.tm_year, &local.tm_mon, &local.tm_mday, &extra) != 3) {
+        return false;
+    }
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_mday += extraDays;
+    local.tm_isdst = -1;
+    std::time_t seconds = std::mktime(&local);
+    if (seconds == static_cast<std::time_t>(-1)) return false;
+    micros = static_cast<int64_t>(seconds) * 1000000;
+    return true;
+}
+
+enum class TransactionType : uint8_t { Deposit, Withdrawal, Interest, TransferOut, TransferIn };
+
+struct Transaction {
+    int64_t timestamp;  // microseconds since the epoch
+    Cents amount;
+    TransactionType type;
+};
+
+std::string describe(const Transaction& t) {
+    std::string text = formatTime(t.timestamp) + "  ";
+    switch (t.type) {
+        case TransactionType::Deposit:
+            return text + "Deposited $" + formatCents(t.amount);
+        case TransactionType::Withdrawal:
+            return text + "Withdrew $" + formatCents(t.amount);
+        case TransactionType::Interest:
+            return text + "Applied interest: $" + formatCents(t.amount);
+        case TransactionType::TransferOut:
+            return text + "Transferred out $" + formatCents(t.amount);
+        case TransactionType::TransferIn:
+            return text + "Transferred in $" + formatCents(t.amount);
+    }
+    return text;
+}
+
+// The record's effect on the balance.
+Cents signedAmount(const Transaction& t) {
+    bool debit = t.type == TransactionType::Withdrawal || t.type == TransactionType::TransferOut;
+    return debit ? -t.amount : t.amount;
+}
+
+constexpr size_t transactionTypeCount = 5;
+
+const char* transactionTypeName(TransactionType type) {
+    switch (type) {
+        case TransactionType::Deposit: return "Deposits";
+        case TransactionType::Withdrawal: return "Withdrawals";
+        case TransactionType::Interest: return "Interest";
+        case TransactionType::TransferOut: return "Transfers out";
+        case TransactionType::TransferIn: return "Transfers in";
+    }
+    return "?";
+}
+
+// Count and sum of amounts per transaction type.
+struct TypeTotals {
+    uint64_t count[transactionTypeCount] = {};
+    Cents amount[transactionTypeCount] = {};
+
+    void add(const Transaction& t) {
+        ++count[static_cast<size_t>(t.type)];
+        amount[static_cast<size_t>(t.type)] += t.amount;
+    }
+
+    void merge(const TypeTotals& other) {
+        for (size_t k = 0; k < transactionTypeCount; ++k) {
+            count[k] += other.count[k];
+            amount[k] += other.amount[k];
+        }
+    }
+};
+
+// Append-only, time-ordered transaction records in chunks. Chunks start at
+// firstChunk records and double up to maxChunk, so an account with a short
+// history only pays for a small chunk, and appending never moves a record.
+//
+// Each chunk has a summary (its last timestamp, first index and per-type
+// totals) kept up to date on append. The summaries are a sparse index:
+// a time lookup binary-searches them and then one chunk, and a totals query
+// over a range reads summaries for whole chunks and scans at most the two
+// partial chunks at its ends.
+//
+// Timestamps never decrease: a record older than its predecessor (the wall
+// clock stepped back) is stored with the predecessor's time.
+class TransactionLog {
+public:
+    static constexpr size_t firstChunk = 16;
+    static constexpr size_t maxChunk = 1024;
+
+    void append(Transaction t) {
+        if (count > 0 && t.timestamp < summaries.back().last) t.timestamp = summaries.back().last;
+        if (next == limit) grow(t.timestamp);
+        *next++ = t;
+        ++count;
+        Summary& summary = summaries.back();
+        summary.last = t.timestamp;
+        summary.totals.add(t);
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const Transaction& operator[](size_t i) const {
+        size_t chunk = chunkOf(i);
+        return chunks[chunk][i - summaries[chunk].begin];
+    }
+
+    // Index of the first record at or after timestamp (size() if none).
+    size_t lowerBound(int64_t timestamp) const {
+        auto chunk = std::partition_point(summaries.begin(), summaries.end(),
+                                          [&](const Summary& s) { return s.last < timestamp; });
+        if (chunk == summaries.end()) return count;
+        size_t k = static_cast<size_t>(chunk - summaries.begin());
+        const Transaction* records = chunks[k].get();
+        const Transaction* end = records + std::min(capacityOf(k), count - chunk->begin);
+        const Transaction* found = std::partition_point(records, end,
+                                                        [&](const Transaction& t) { return t.timestamp < timestamp; });
+        return chunk->begin + static_cast<size_t>(found - records);
+    }
+
+    // Totals for records with from <= timestamp < to.
+    TypeTotals totals(int64_t from, int64_t to) const {
+        TypeTotals result;
+        size_t i = lowerBound(from);
+        size_t end = to > from ? lowerBound(to) : i;
+        while (i < end) {
+            size_t chunk = chunkOf(i);
+            const Summary& summary = summaries[chunk];
+            size_t chunkEnd = summary.begin + std::min(capacityOf(chunk), count - summary.begin);
+            if (i == summary.begin && chunkEnd <= end) {
+                result.merge(summary.totals);
+                i = chunkEnd;
+                continue;
+            }
+            for (size_t stop = std::min(chunkEnd, end); i < stop; ++i) result.add((*this)[i]);
+        }
+        return result;
+    }
 
-class BankAccount {
 private:
-    std::string owner;
-    double balance;
-    double interestRate;
-    std::vector<std::string> transactions;
+    struct Summary {
+        int64_t last;
+        size_t begin;  // index of the chunk's first record
+        TypeTotals totals;
+    };
+
+    // Chunks 0 .. doublings-1 double from firstChunk; the rest are maxChunk.
+    static constexpr size_t doublings = 7;
+    static constexpr size_t doublingRecords = firstChunk * ((size_t(1) << doublings) - 1);
+    static_assert(firstChunk << (doublings - 1) == maxChunk, "chunk sizes must double up to maxChunk");
+
+    static size_t capacityOf(size_t chunk) { return chunk < doublings ? firstChunk << chunk : maxChunk; }
+
+    static size_t chunkOf(size_t i) {
+        if (i < doublingRecords) return 63 - __builtin_clzll((i + firstChunk) / firstChunk);
+        return doublings + (i - doublingRecords) / maxChunk;
+    }
+
+    void grow(int64_t timestamp) {
+        size_t size = capacityOf(chunks.size());
+        chunks.push_back(std::unique_ptr<Transaction[]>(new Transaction[size]));
+        summaries.push_back({ timestamp, count, TypeTotals() });
+        next = chunks.back().get();
+        limit = next + size;
+    }
+
+    std::vector<std::unique_ptr<Transaction[]>> chunks;
+    std::vector<Summary> summaries;
+    Transaction* next = nullptr;
+    Transaction* limit = nullptr;
+    size_t count = 0;
+};
+
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
 
+inline uint64_t hashText(std::string_view text) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (char c : text) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001B3ULL;
+    }
+    return mix64(h);
+}
+
+// Owner names interned in a chunked arena, plus an open-addressing index
+// (linear probing) from name to dense account id. An arena entry is
+// u32 id, u16 length, then the name, 4-byte aligned. A slot is 8 bytes: the
+// top 32 bits of the name's hash and the entry's offset in 4-byte units. A
+// lookup reads one slot (its neighbours share the cache line) and, when the
+// hash matches, one arena entry, so it costs about two cache misses however
+// many accounts there are. Chunks never move, so interned names can be
+// handed out as string_views.
+class OwnerIndex {
 public:
-    BankAccount(const std::string& ownerName, double initialBalance = 0.0, double rate = 0.035)
-        : owner(ownerName), balance(initialBalance), interestRate(rate) {}
+    static constexpr uint32_t notFound = UINT32_MAX;
+    static constexpr size_t maxNameLength = UINT16_MAX;
 
-    void deposit(double amount) {
-        if (amount <= 0) {
-            std::cout << "Deposit amount must be positive.\n";
-            return;
+    uint32_t find(std::string_view name) const {
+        if (slots.empty()) return notFound;
+        uint32_t hash = hashOf(name);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i].entry != Empty; i = (i + 1) & mask) {
+            if (slots[i].hash != hash) continue;
+            const char* entry = entryAt(slots[i].entry);
+            if (getLength(entry) == name.size() && std::memcmp(entry + 6, name.data(), name.size()) == 0) {
+                return getId(entry);
+            }
         }
-        balance += amount;
-        transactions.push_back("Deposited $" + std::to_string(amount));
-        std::cout << "Deposited $" << amount << ". New balance: $" << balance << "\n";
+        return notFound;
     }
 
-    void withdraw(double amount) {
-        if (amount <= 0) {
-            std::cout << "Withdrawal amount must be positive.\n";
-            return;
+    // Interns a name that is not in the index yet and maps it to id.
+    // Returns the interned copy, which lives as long as the index.
+    std::string_view insert(std::string_view name, uint32_t id) {
+        if ((count + 1) * 4 > slots.size() * 3) rehash(count + 1);
+        size_t bytes = (6 + name.size() + 3) & ~size_t(3);
+        if (chunks.empty() || chunkUsed + bytes > chunkBytes) {
+            chunks.push_back(std::unique_ptr<char[]>(new char[chunkBytes]));
+            chunkUsed = 0;
         }
-        if (amount > balance) {
-            std::cout << "Insufficient funds. Withdrawal cancelled.\n";
-            return;
+        char* entry = chunks.back().get() + chunkUsed;
+        uint32_t offset = static_cast<uint32_t>(((chunks.size() - 1) * chunkBytes + chunkUsed) / 4);
+        chunkUsed += bytes;
+        std::memcpy(entry, &id, 4);
+        uint16_t length = static_cast<uint16_t>(name.size());
+        std::memcpy(entry + 4, &length, 2);
+        std::memcpy(entry + 6, name.data(), name.size());
+
+        uint32_t hash = hashOf(name);
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].entry != Empty) i = (i + 1) & mask;
+        slots[i] = { hash, offset };
+        ++count;
+        return std::string_view(entry + 6, name.size());
+    }
+
+    // Sizes the table for count names up front.
+    void reserve(size_t expected) {
+        if ((expected + 1) * 4 > slots.size() * 3) rehash(expected);
+    }
+
+    size_t size() const { return count; }
+
+private:
+    static constexpr size_t chunkBytes = 1 << 20;
+    static constexpr uint32_t Empty = UINT32_MAX;
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t entry;
+    };
+
+    static uint32_t hashOf(std::string_view name) { return static_cast<uint32_t>(hashText(name) >> 32); }
+
+    static uint32_t getId(const char* entry) {
+        uint32_t id;
+        std::memcpy(&id, entry, 4);
+        return id;
+    }
+
+    static size_t getLength(const char* entry) {
+        uint16_t length;
+        std::memcpy(&length, entry + 4, 2);
+        return length;
+    }
+
+    const char* entryAt(uint32_t offset) const {
+        size_t byte = static_cast<size_t>(offset) * 4;
+        return chunks[byte / chunkBytes].get() + byte % chunkBytes;
+    }
+
+    // Slots keep their hash, so growing never rereads the names.
+    void rehash(size_t expected) {
+        size_t capacity = 16;
+        while (capacity * 3 < expected * 4 + 4) capacity *= 2;
+        std::vector<Slot> old(capacity, Slot{ 0, Empty });
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.entry == Empty) continue;
+            size_t i = slot.hash & mask;
+            while (slots[i].entry != Empty) i = (i + 1) & mask;
+            slots[i] = slot;
         }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunkUsed = 0;
+    size_t count = 0;
+};
+
+enum class TransactionStatus { Ok, InvalidAmount, InsufficientFunds, LogFailed };
+
+class BankAccount {
+private:
+    std::string_view owner;  // interned; outlives the account
+    Cents balance;
+    RatePpm interestRate;
+    TransactionLog transactions;
+
+public:
+    static constexpr RatePpm defaultInterestRate = 35000;
+
+    BankAccount(std::string_view ownerName, Cents initialBalance = 0, RatePpm rate = defaultInterestRate)
+        : owner(ownerName), balance(initialBalance), interestRate(rate) {}
+
+    std::string_view getOwner() const { return owner; }
+    Cents getBalance() const { return balance; }
+    RatePpm getInterestRate() const { return interestRate; }
+    const TransactionLog& getHistory() const { return transactions; }
+
+    // Whether deposit/withdraw would succeed, without changing anything.
+    TransactionStatus checkDeposit(Cents amount) const {
+        return amount <= 0 ? TransactionStatus::InvalidAmount : TransactionStatus::Ok;
+    }
+
+    TransactionStatus checkWithdrawal(Cents amount) const {
+        if (amount <= 0) return TransactionStatus::InvalidAmount;
+        if (amount > balance) return TransactionStatus::InsufficientFunds;
+        return TransactionStatus::Ok;
+    }
+
+    TransactionStatus deposit(Cents amount, int64_t timestamp) {
+        TransactionStatus status = checkDeposit(amount);
+        if (status != TransactionStatus::Ok) return status;
+        balance += amount;
+        transactions.append({ timestamp, amount, TransactionType::Deposit });
+        return TransactionStatus::Ok;
+    }
+
+    TransactionStatus withdraw(Cents amount, int64_t timestamp) {
+        TransactionStatus status = checkWithdrawal(amount);
+        if (status != TransactionStatus::Ok) return status;
         balance -= amount;
-        transactions.push_back("Withdrew $" + std::to_string(amount));
-        std::cout << "Withdrew $" << amount << ". New balance: $" << balance << "\n";
+        transactions.append({ timestamp, amount, TransactionType::Withdrawal });
+        return TransactionStatus::Ok;
     }
 
-    void checkBalance() const {
-        std::cout << owner << "'s current balance: $" << balance << "\n";
+    // Returns the interest credited.
+    Cents applyInterest(int64_t timestamp) {
+        Cents interest = applyRate(balance, interestRate);
+        balance += interest;
+        transactions.append({ timestamp, interest, TransactionType::Interest });
+        return interest;
+    }
+
+    TransactionStatus transferTo(BankAccount& other, Cents amount, int64_t timestamp) {
+        if (amount <= 0 || &other == this) return TransactionStatus::InvalidAmount;
+        if (amount > balance) return TransactionStatus::InsufficientFunds;
+        balance -= amount;
+        other.balance += amount;
+        transactions.append({ timestamp, amount, TransactionType::TransferOut });
+        other.transactions.append({ timestamp, amount, TransactionType::TransferIn });
+        return TransactionStatus::Ok;
     }
 
-    void applyInterest() {
-        double interest = balance * interestRate;
+    // Posts interest worked out elsewhere, by the month-end batch.
+    void postInterest(Cents interest, int64_t timestamp) {
         balance += interest;
-        transactions.push_back("Applied interest: $" + std::to_string(interest));
-        std::cout << "Interest of $" << interest << " applied. New balance: $" << balance << "\n";
+        transactions.append({ timestamp, interest, TransactionType::Interest });
+    }
+
+    // Re-applies a journal record during recovery; it was validated when it
+    // was first written.
+    void restore(const Transaction& t) {
+        balance += signedAmount(t);
+        transactions.append(t);
+    }
+
+    void checkBalance() const {
+        std::cout << owner << "'s current balance: $" << formatCents(balance) << "\n";
+    }
+};
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = true;
+    }
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFU;
+}
+
+void putLE(std::string& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+void syncDirectoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+enum class WalRecordType : uint8_t { Open, Deposit, Withdrawal, Interest, Transfer };
+
+// One logged change. Names point at the caller's strings while appending and
+// into the file buffer while replaying.
+struct WalRecord {
+    uint64_t lsn = 0;
+    WalRecordType type = WalRecordType::Deposit;
+    int64_t timestamp = 0;
+    Cents amount = 0;
+    RatePpm rate = 0;         // Open only
+    std::string_view owner;
+    std::string_view target;  // Transfer only
+};
+
+// Write-ahead log with group commit. append() only copies the record into a
+// buffer; a flusher thread writes whatever has accumulated and covers it with
+// one fdatasync. While one sync is in flight the next batch builds up, so
+// concurrent committers share syncs instead of queueing for one each.
+//
+// Record: u32 payload length, u32 crc32(payload), payload =
+//   u64 lsn, u8 type, i64 timestamp, i64 amount, u16 owner length, owner,
+//   then i64 rate for Open, or u16 target length, target for Transfer.
+class WriteAheadLog {
+public:
+    WriteAheadLog(const std::string& path, uint64_t lastLsn)
+        : appended(lastLsn), durable(lastLsn) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            std::cerr << "Error opening bank log!\n";
+            failed = true;
+        }
+        flusher = std::thread([this] { flushLoop(); });
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeFlusher.notify_one();
+        flusher.join();
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Queues a record and returns its LSN; it is durable once
+    // waitDurable(lsn) returns.
+    uint64_t append(const WalRecord& r) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool idle = buffer.empty();
+        size_t start = buffer.size();
+        buffer.append(8, '\0');
+        putLE(buffer, ++appended, 8);
+        buffer.push_back(static_cast<char>(r.type));
+        putLE(buffer, static_cast<uint64_t>(r.timestamp), 8);
+        putLE(buffer, static_cast<uint64_t>(r.amount), 8);
+        putLE(buffer, r.owner.size(), 2);
+        buffer += r.owner;
+        if (r.type == WalRecordType::Open) putLE(buffer, static_cast<uint64_t>(r.rate), 8);
+        if (r.type == WalRecordType::Transfer) {
+            putLE(buffer, r.target.size(), 2);
+            buffer += r.target;
+        }
+
+        size_t length = buffer.size() - start - 8;
+        uint32_t crc = crc32(reinterpret_cast<const uint8_t*>(buffer.data()) + start + 8, length);
+        for (int i = 0; i < 4; ++i) {
+            buffer[start + i] = static_cast<char>(length >> (8 * i));
+            buffer[start + 4 + i] = static_cast<char>(crc >> (8 * i));
+        }
+        if (idle) wakeFlusher.notify_one();
+        return appended;
+    }
+
+    // Blocks until every record up to lsn is on disk; false if a write failed.
+    bool waitDurable(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        becameDurable.wait(lock, [&] { return durable >= lsn; });
+        return !failed;
+    }
+
+    // Empties the log once everything appended so far is durable. Used after
+    // a snapshot has captured those records.
+    bool truncate() {
+        std::unique_lock<std::mutex> lock(mutex);
+        becameDurable.wait(lock, [&] { return durable == appended; });
+        if (fd < 0 || ftruncate(fd, 0) != 0 || fsync(fd) != 0) {
+            std::cerr << "Error truncating bank log!\n";
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t lastLsn() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return appended;
+    }
+
+    uint64_t syncCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return syncs;
+    }
+
+    // Decodes one payload; false if it is malformed.
+    static bool decode(const uint8_t* p, size_t length, WalRecord& r) {
+        const uint8_t* end = p + length;
+        if (length < 27) return false;
+        r.lsn = getLE(p, 8);
+        r.type = static_cast<WalRecordType>(p[8]);
+        if (p[8] > static_cast<uint8_t>(WalRecordType::Transfer)) return false;
+        r.timestamp = static_cast<int64_t>(getLE(p + 9, 8));
+        r.amount = static_cast<Cents>(getLE(p + 17, 8));
+        size_t ownerLength = static_cast<size_t>(getLE(p + 25, 2));
+        p += 27;
+        if (static_cast<size_t>(end - p) < ownerLength) return false;
+        r.owner = std::string_view(reinterpret_cast<const char*>(p), ownerLength);
+        p += ownerLength;
+        if (r.type == WalRecordType::Open) {
+            if (end - p < 8) return false;
+            r.rate = static_cast<RatePpm>(getLE(p, 8));
+            p += 8;
+        }
+        if (r.type == WalRecordType::Transfer) {
+            if (end - p < 2) return false;
+            size_t targetLength = static_cast<size_t>(getLE(p, 2));
+            p += 2;
+            if (static_cast<size_t>(end - p) < targetLength) return false;
+            r.target = std::string_view(reinterpret_cast<const char*>(p), targetLength);
+            p += targetLength;
+        }
+        return p == end;
+    }
+
+private:
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wakeFlusher.wait(lock, [&] { return stopping || !buffer.empty(); });
+            if (buffer.empty()) return;
+            writing.swap(buffer);
+            uint64_t batchEnd = appended;
+            lock.unlock();
+
+            bool ok = fd >= 0;
+            for (size_t done = 0; ok && done < writing.size();) {
+                ssize_t n = ::write(fd, writing.data() + done, writing.size() - done);
+                if (n < 0 && errno == EINTR) continue;
+                ok = n > 0;
+                done += ok ? static_cast<size_t>(n) : 0;
+            }
+            ok = ok && fdatasync(fd) == 0;
+            writing.clear();
+
+            lock.lock();
+            if (!ok && !failed) std::cerr << "Error writing bank log!\n";
+            failed = failed || !ok;
+            durable = batchEnd;
+            ++syncs;
+            becameDurable.notify_all();
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeFlusher;
+    std::condition_variable becameDurable;
+    std::string buffer;   // appended, not yet handed to the flusher
+    std::string writing;  // flusher-only; keeps its capacity between batches
+    uint64_t appended;
+    uint64_t durable;
+    uint64_t syncs = 0;
+    bool failed = false;
+    bool stopping = false;
+    int fd = -1;
+    std::thread flusher;
+};
+
+// The accounts plus their durability. Accounts are stored contiguously by
+// dense id, and owners maps names to ids. Every change is applied, appended to
+// the write-ahead log and made durable before it is acknowledged. Every
+// snapshotEvery records the whole ledger is written to a snapshot and the log
+// is emptied, so recovery replays at most that many records.
+//
+// Snapshot: "BANKSNP1", u64 lsn, u64 account count, then per account
+//   u16 owner length, owner, i64 rate, i64 opening balance, u64 history
+//   length, history as (i64 timestamp, i64 amount, u8 type); then u32
+//   crc32 of everything before it. Log records the snapshot covers (lsn at
+//   or below its lsn) are skipped on replay, so a crash between writing the
+//   snapshot and emptying the log is harmless.
+class Ledger {
+public:
+    static constexpr uint64_t snapshotEvery = 10000;
+
+    Ledger(const std::string& logFile, const std::string& snapshotFile)
+        : logPath(logFile), snapshotPath(snapshotFile) {
+        uint64_t lsn = loadSnapshot();
+        size_t snapshotAccounts = accounts.size();
+
+        std::string log = readFile(logPath);
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(log.data());
+        size_t pos = 0;
+        uint64_t replayed = 0;
+        while (pos + 8 <= log.size()) {
+            uint32_t length = static_cast<uint32_t>(getLE(bytes + pos, 4));
+            uint32_t crc = static_cast<uint32_t>(getLE(bytes + pos + 4, 4));
+            WalRecord r;
+            if (length > log.size() - pos - 8 || crc32(bytes + pos + 8, length) != crc ||
+                !WriteAheadLog::decode(bytes + pos + 8, length, r)) {
+                break;
+            }
+            if (r.lsn > lsn) {
+                apply(r);
+                lsn = r.lsn;
+                ++replayed;
+            }
+            pos += 8 + length;
+        }
+        // Drop a record torn by a crash so new records follow valid ones.
+        if (pos < log.size() && ::truncate(logPath.c_str(), static_cast<off_t>(pos)) != 0) {
+            std::cerr << "Error repairing bank log!\n";
+        }
+        sinceSnapshot = replayed;
+
+        if (snapshotAccounts > 0 || replayed > 0) {
+            std::cout << "Recovered " << accounts.size() << " account(s): " << snapshotAccounts
+                      << " from the snapshot, " << replayed << " log record(s) replayed.\n";
+        }
+        wal = std::make_unique<WriteAheadLog>(logPath, lsn);
+    }
+
+    // The pointer stays valid until the next account is opened.
+    BankAccount* find(std::string_view owner) {
+        uint32_t id = owners.find(owner);
+        return id == OwnerIndex::notFound ? nullptr : &accounts[id];
+    }
+
+    enum class OpenStatus { Ok, Unavailable, LogFailed };
+
+    // Every change below is checked, logged and made durable before it is
+    // applied, so a failed log write refuses the change and leaves the
+    // accounts as they were.
+
+    // Unavailable if the owner already has an account or the name is too long.
+    OpenStatus open(std::string_view owner) {
+        if (owner.size() > OwnerIndex::maxNameLength || owners.find(owner) != OwnerIndex::notFound) {
+            return OpenStatus::Unavailable;
+        }
+        WalRecord r;
+        r.type = WalRecordType::Open;
+        r.timestamp = nowMicros();
+        r.amount = 0;
+        r.rate = BankAccount::defaultInterestRate;
+        r.owner = owner;
+        if (!commit(r)) return OpenStatus::LogFailed;
+        create(owner, r.amount, r.rate);
+        return OpenStatus::Ok;
+    }
+
+    TransactionStatus deposit(BankAccount& account, Cents amount) {
+        TransactionStatus status = account.checkDeposit(amount);
+        if (status != TransactionStatus::Ok) return status;
+        int64_t timestamp = nowMicros();
+        if (!commit(record(WalRecordType::Deposit, account, amount, timestamp))) return TransactionStatus::LogFailed;
+        return account.deposit(amount, timestamp);
+    }
+
+    TransactionStatus withdraw(BankAccount& account, Cents amount) {
+        TransactionStatus status = account.checkWithdrawal(amount);
+        if (status != TransactionStatus::Ok) return status;
+        int64_t timestamp = nowMicros();
+        if (!commit(record(WalRecordType::Withdrawal, account, amount, timestamp))) return TransactionStatus::LogFailed;
+        return account.withdraw(amount, timestamp);
     }
 
-    void showTransactionHistory() const {
-        std::cout << "--- Transaction History for " << owner << " ---\n";
-        if (transactions.empty()) {
-            std::cout << "No transactions yet.\n";
+    // Sets interest to the amount credited; false if it could not be logged.
+    bool applyInterest(BankAccount& account, Cents& interest) {
+        int64_t timestamp = nowMicros();
+        interest = applyRate(account.getBalance(), account.getInterestRate());
+        if (!commit(record(WalRecordType::Interest, account, interest, timestamp))) return false;
+        account.postInterest(interest, timestamp);
+        return true;
+    }
+
+    const std::vector<BankAccount>& allAccounts() const { return accounts; }
+
+    // Posts credited[id] to every account id as one batch: the records share
+    // a single sync instead of waiting for one each. False, with nothing
+    // posted, if the batch could not be logged.
+    bool postInterest(const Cents* credited, int64_t timestamp) {
+        uint64_t lsn = wal->lastLsn();
+        for (size_t id = 0; id < accounts.size(); ++id) {
+            lsn = wal->append(record(WalRecordType::Interest, accounts[id], credited[id], timestamp));
+        }
+        sinceSnapshot += accounts.size();
+        if (!wal->waitDurable(lsn)) return false;
+        for (size_t id = 0; id < accounts.size(); ++id) accounts[id].postInterest(credited[id], timestamp);
+        return true;
+    }
+
+    // Takes a snapshot once snapshotEvery records have been logged since the
+    // last one. Callers run this between operations, after acknowledging
+    // them, since a snapshot costs O(total history): it rewrites and syncs
+    // every account's full transaction history.
+    void snapshotIfDue() {
+        if (sinceSnapshot >= snapshotEvery) snapshot();
+    }
+
+    // Writes every account to a new snapshot and empties the log. O(total
+    // history); see snapshotIfDue.
+    bool snapshot() {
+        uint64_t lsn = wal->lastLsn();
+        if (!wal->waitDurable(lsn)) return false;
+
+        std::string data = "BANKSNP1";
+        putLE(data, lsn, 8);
+        putLE(data, accounts.size(), 8);
+        for (const BankAccount& account : accounts) {
+            const TransactionLog& history = account.getHistory();
+            Cents opening = account.getBalance();
+            for (size_t i = 0; i < history.size(); ++i) opening -= signedAmount(history[i]);
+            putLE(data, account.getOwner().size(), 2);
+            data += account.getOwner();
+            putLE(data, static_cast<uint64_t>(account.getInterestRate()), 8);
+            putLE(data, static_cast<uint64_t>(opening), 8);
+            putLE(data, history.size(), 8);
+            for (size_t i = 0; i < history.size(); ++i) {
+                putLE(data, static_cast<uint64_t>(history[i].timestamp), 8);
+                putLE(data, static_cast<uint64_t>(history[i].amount), 8);
+                data.push_back(static_cast<char>(history[i].type));
+            }
+        }
+        putLE(data, crc32(reinterpret_cast<const uint8_t*>(data.data()), data.size()), 4);
+
+        // Temporary file, sync, rename: a crash leaves the old or the new
+        // snapshot, never a truncated one.
+        const std::string tmp = snapshotPath + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()) &&
+                  fsync(fd) == 0;
+        if (fd >= 0) ::close(fd);
+        if (!ok || std::rename(tmp.c_str(), snapshotPath.c_str()) != 0) {
+            std::cerr << "Error saving bank snapshot!\n";
+            std::remove(tmp.c_str());
+            return false;
+        }
+        syncDirectoryOf(snapshotPath);
+        sinceSnapshot = 0;
+        return wal->truncate();
+    }
+
+private:
+    static WalRecord record(WalRecordType type, const BankAccount& account, Cents amount, int64_t timestamp) {
+        WalRecord r;
+        r.type = type;
+        r.timestamp = timestamp;
+        r.amount = amount;
+        r.owner = account.getOwner();
+        return r;
+    }
+
+    // Logs r and waits until it is durable; false if the log write failed.
+    bool commit(const WalRecord& r) {
+        ++sinceSnapshot;
+        return wal->waitDurable(wal->append(r));
+    }
+
+    // Returns the snapshot's lsn, or 0 when there is no usable snapshot.
+    uint64_t loadSnapshot() {
+        std::string data = readFile(snapshotPath);
+        if (data.empty()) return 0;
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+        const uint8_t* end = p + data.size();
+        if (data.size() < 28 || data.compare(0, 8, "BANKSNP1") != 0 ||
+            crc32(p, data.size() - 4) != getLE(end - 4, 4)) {
+            std::cerr << "Error loading bank snapshot!\n";
+            return 0;
+        }
+        end -= 4;
+        uint64_t lsn = getLE(p + 8, 8);
+        uint64_t count = getLE(p + 16, 8);
+        p += 24;
+        if (count <= static_cast<uint64_t>(end - p) / 26) {
+            owners.reserve(count);
+            accounts.reserve(count);
+        }
+        for (uint64_t a = 0; a < count; ++a) {
+            if (end - p < 2) break;
+            size_t ownerLength = static_cast<size_t>(getLE(p, 2));
+            if (static_cast<size_t>(end - p) < 2 + ownerLength + 24) break;
+            std::string_view owner(reinterpret_cast<const char*>(p + 2), ownerLength);
+            p += 2 + ownerLength;
+            RatePpm rate = static_cast<RatePpm>(getLE(p, 8));
+            Cents opening = static_cast<Cents>(getLE(p + 8, 8));
+            uint64_t historyLength = getLE(p + 16, 8);
+            p += 24;
+            if (static_cast<uint64_t>(end - p) / 17 < historyLength || owners.find(owner) != OwnerIndex::notFound) break;
+            BankAccount& account = create(owner, opening, rate);
+            for (uint64_t i = 0; i < historyLength; ++i, p += 17) {
+                account.restore({ static_cast<int64_t>(getLE(p, 8)), static_cast<Cents>(getLE(p + 8, 8)),
+                                  static_cast<TransactionType>(p[16]) });
+            }
+        }
+        return lsn;
+    }
+
+    BankAccount& create(std::string_view owner, Cents balance, RatePpm rate) {
+        uint32_t id = static_cast<uint32_t>(accounts.size());
+        accounts.emplace_back(owners.insert(owner, id), balance, rate);
+        return accounts.back();
+    }
+
+    void apply(const WalRecord& r) {
+        if (r.type == WalRecordType::Open) {
+            if (owners.find(r.owner) == OwnerIndex::notFound) create(r.owner, r.amount, r.rate);
             return;
         }
-        for (const auto& t : transactions) {
-            std::cout << t << "\n";
+        BankAccount* account = find(r.owner);
+        if (!account) return;
+        switch (r.type) {
+            case WalRecordType::Deposit:
+                account->restore({ r.timestamp, r.amount, TransactionType::Deposit });
+                break;
+            case WalRecordType::Withdrawal:
+                account->restore({ r.timestamp, r.amount, TransactionType::Withdrawal });
+                break;
+            case WalRecordType::Interest:
+                account->restore({ r.timestamp, r.amount, TransactionType::Interest });
+                break;
+            case WalRecordType::Transfer:
+                if (BankAccount* target = find(r.target)) {
+                    account->restore({ r.timestamp, r.amount, TransactionType::TransferOut });
+                    target->restore({ r.timestamp, r.amount, TransactionType::TransferIn });
+                }
+                break;
+            case WalRecordType::Open:
+                break;
+        }
+    }
+
+    OwnerIndex owners;
+    std::vector<BankAccount> accounts;  // indexed by account id
+    std::string logPath;
+    std::string snapshotPath;
+    std::unique_ptr<WriteAheadLog> wal;
+    uint64_t sinceSnapshot = 0;
+};
+
+enum class OperationType : uint8_t { Deposit, Withdraw, Transfer, Interest };
+constexpr size_t operationTypeCount = 4;
+
+const char* operationName(OperationType type) {
+    switch (type) {
+        case OperationType::Deposit: return "deposit";
+        case OperationType::Withdraw: return "withdraw";
+        case OperationType::Transfer: return "transfer";
+        case OperationType::Interest: return "interest";
+    }
+    return "?";
+}
+
+// One entry of a transaction stream. Accounts are indices into the engine's
+// account table; target is only used by transfers.
+struct Operation {
+    Cents amount;
+    uint32_t account;
+    uint32_t target;
+    OperationType type;
+};
+
+// Latency histogram with 8 linear sub-buckets per power of two, so any
+// reported percentile is within 12.5% of the true value.
+class LatencyHistogram {
+public:
+    void record(uint64_t nanos) {
+        ++buckets[bucketOf(nanos)];
+        ++total;
+        if (nanos > largest) largest = nanos;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t b = 0; b < bucketCount; ++b) buckets[b] += other.buckets[b];
+        total += other.total;
+        if (other.largest > largest) largest = other.largest;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return largest; }
+
+    // Upper bound of the bucket holding the q-quantile.
+    uint64_t percentile(double q) const {
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < bucketCount; ++b) {
+            seen += buckets[b];
+            if (seen > rank) return std::min(upperBound(b), largest);
+        }
+        return largest;
+    }
+
+private:
+    static constexpr unsigned subBits = 3;
+    static constexpr size_t bucketCount = (64 - subBits + 1) << subBits;
+
+    static size_t bucketOf(uint64_t v) {
+        if (v < (1u << subBits)) return static_cast<size_t>(v);
+        unsigned shift = 63 - __builtin_clzll(v) - subBits;
+        return ((shift + 1) << subBits) + ((v >> shift) & ((1u << subBits) - 1));
+    }
+
+    static uint64_t upperBound(size_t b) {
+        if (b < (1u << subBits)) return b;
+        unsigned shift = static_cast<unsigned>(b >> subBits) - 1;
+        uint64_t lower = static_cast<uint64_t>((1u << subBits) + (b & ((1u << subBits) - 1))) << shift;
+        return lower + ((uint64_t(1) << shift) - 1);
+    }
+
+    uint64_t buckets[bucketCount] = {};
+    uint64_t total = 0;
+    uint64_t largest = 0;
+};
+
+// Fixed-capacity ring between the thread feeding the stream and one worker.
+// Pushes are published in small batches so the two threads are not trading
+// the tail's cache line on every operation.
+class OperationQueue {
+public:
+    static constexpr size_t capacity = 4096;
+    static constexpr size_t publishEvery = 32;
+
+    bool tryPush(const Operation& op) {
+        if (pending - headCache == capacity) {
+            headCache = head.load(std::memory_order_acquire);
+            if (pending - headCache == capacity) {
+                publish();
+                return false;
+            }
+        }
+        slots[pending % capacity] = op;
+        if (++pending - published >= publishEvery) publish();
+        return true;
+    }
+
+    void publish() {
+        if (pending == published) return;
+        published = pending;
+        tail.store(published, std::memory_order_release);
+    }
+
+    // Calls fn on queued operations (at most a few hundred, so the producer
+    // gets slots back promptly) and returns how many there were.
+    template <class Fn>
+    size_t drain(Fn&& fn) {
+        size_t first = head.load(std::memory_order_relaxed);
+        size_t last = std::min(tail.load(std::memory_order_acquire), first + 256);
+        for (size_t i = first; i != last; ++i) fn(slots[i % capacity]);
+        head.store(last, std::memory_order_release);
+        return last - first;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    // Producer-only bookkeeping.
+    alignas(64) size_t pending = 0;
+    size_t published = 0;
+    size_t headCache = 0;
+    alignas(64) Operation slots[capacity];
+};
+
+// Spinlock padded to a cache line so neighbouring accounts owned by
+// different workers do not false-share.
+struct alignas(64) AccountLock {
+    std::atomic<bool> held{false};
+
+    void lock() {
+        while (held.exchange(true, std::memory_order_acquire)) {
+            while (held.load(std::memory_order_relaxed)) std::this_thread::yield();
+        }
+    }
+
+    void unlock() { held.store(false, std::memory_order_release); }
+};
+
+struct EngineReport {
+    double seconds = 0;
+    unsigned workers = 0;
+    LatencyHistogram latency[operationTypeCount];
+    uint64_t failed[operationTypeCount] = {};
+    // Only filled in when the engine writes a log.
+    LatencyHistogram commitWait;
+    uint64_t syncs = 0;
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (const LatencyHistogram& h : latency) sum += h.count();
+        return sum;
+    }
+
+    void print() const {
+        std::cout << "Processed " << total() << " transactions on " << workers << " worker thread(s) in "
+                  << std::fixed << std::setprecision(3) << seconds << " s ("
+                  << std::setprecision(2) << total() / seconds / 1e6 << " million/s)\n";
+        std::cout << std::left << std::setw(10) << "type" << std::right << std::setw(12) << "count"
+                  << std::setw(10) << "failed" << std::setw(9) << "p50" << std::setw(9) << "p99"
+                  << std::setw(9) << "p99.9" << std::setw(10) << "max" << "   (latency in ns)\n";
+        for (size_t t = 0; t < operationTypeCount; ++t) {
+            const LatencyHistogram& h = latency[t];
+            std::cout << std::left << std::setw(10) << operationName(static_cast<OperationType>(t))
+                      << std::right << std::setw(12) << h.count() << std::setw(10) << failed[t]
+                      << std::setw(9) << h.percentile(0.5) << std::setw(9) << h.percentile(0.99)
+                      << std::setw(9) << h.percentile(0.999) << std::setw(10) << h.max() << "\n";
+        }
+        if (syncs > 0) {
+            std::cout << "Group commit: " << syncs << " log syncs, " << std::setprecision(1)
+                      << static_cast<double>(total()) / syncs << " transactions per sync; batch commit wait p50 "
+                      << commitWait.percentile(0.5) << " ns, p99 " << commitWait.percentile(0.99) << " ns\n";
         }
+        std::cout.unsetf(std::ios::floatfield);
     }
 };
 
+// Replays a transaction stream across worker threads. Each account belongs
+// to one shard (chosen by hashing its index) and every operation is queued
+// to the shard of the account it names, so an account's own deposits,
+// withdrawals and interest are applied in stream order. Transfers are the
+// exception: the source's worker also credits the target, which may belong
+// to another shard, so the credit runs concurrently with the target shard's
+// own operations and lands wherever it wins the lock, not at its place in
+// the stream. Which of the target's later withdrawals succeed can therefore
+// change from run to run; a replay is not deterministic. Transfers take both
+// account locks in index order, so two opposing transfers can never
+// deadlock.
+//
+// Latency is the time an operation spends in its worker (lock wait plus
+// apply), not time spent queued behind other operations.
+//
+// With a write-ahead log, each successful operation is appended while its
+// account locks are held, so the log orders changes to an account the same
+// way they were applied in this run, and recovering from it reproduces the
+// balances the run ended with. A worker waits for its batch to become durable
+// after the batch instead of after every operation, and the log's group
+// commit shares each sync among all workers waiting at that moment.
+class TransactionEngine {
+public:
+    TransactionEngine(std::vector<BankAccount*> accountTable, unsigned workerCount, WriteAheadLog* log = nullptr)
+        : accounts(std::move(accountTable)), locks(accounts.size()), workers(std::max(1u, workerCount)), wal(log) {}
+
+    // Pulls operations from next(op) until it returns false, then waits for
+    // the workers to finish.
+    template <class Source>
+    EngineReport run(Source&& next) {
+        std::vector<std::unique_ptr<OperationQueue>> queues;
+        for (unsigned w = 0; w < workers; ++w) queues.push_back(std::make_unique<OperationQueue>());
+        std::vector<ShardStats> stats(workers);
+        std::atomic<bool> closed{false};
+        uint64_t syncsBefore = wal ? wal->syncCount() : 0;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned w = 0; w < workers; ++w) {
+            threads.emplace_back([&, w] { work(*queues[w], stats[w], closed); });
+        }
+
+        Operation op;
+        size_t sinceFlush = 0;
+        while (next(op)) {
+            OperationQueue& queue = *queues[shardOf(op.account)];
+            while (!queue.tryPush(op)) std::this_thread::yield();
+            // Shards that see little traffic still get their operations promptly.
+            if (++sinceFlush == 1024) {
+                for (auto& q : queues) q->publish();
+                sinceFlush = 0;
+            }
+        }
+        for (auto& q : queues) q->publish();
+        closed.store(true, std::memory_order_release);
+        for (std::thread& t : threads) t.join();
+
+        EngineReport report;
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report.workers = workers;
+        for (const ShardStats& s : stats) {
+            for (size_t t = 0; t < operationTypeCount; ++t) {
+                report.latency[t].merge(s.latency[t]);
+                report.failed[t] += s.failed[t];
+            }
+            report.commitWait.merge(s.commitWait);
+        }
+        if (wal) report.syncs = wal->syncCount() - syncsBefore;
+        return report;
+    }
+
+private:
+    struct alignas(64) ShardStats {
+        LatencyHistogram latency[operationTypeCount];
+        uint64_t failed[operationTypeCount] = {};
+        LatencyHistogram commitWait;
+    };
+
+    unsigned shardOf(uint32_t account) const {
+        uint32_t mixed = account * 0x9E3779B1u;
+        return static_cast<unsigned>((static_cast<uint64_t>(mixed) * workers) >> 32);
+    }
+
+    void work(OperationQueue& queue, ShardStats& stats, const std::atomic<bool>& closed) {
+        using Clock = std::chrono::steady_clock;
+        for (;;) {
+            bool finished = closed.load(std::memory_order_acquire);
+            // Operations in a batch run back to back, so each one's latency
+            // is the gap since the previous one finished: one clock read each.
+            Clock::time_point last = Clock::now();
+            uint64_t batchLsn = 0;
+            uint64_t logged[operationTypeCount] = {};
+            size_t drained = queue.drain([&](const Operation& op) {
+                size_t type = static_cast<size_t>(op.type);
+                if (execute(op, batchLsn) != TransactionStatus::Ok) {
+                    ++stats.failed[type];
+                } else if (wal) {
+                    ++logged[type];
+                }
+                Clock::time_point now = Clock::now();
+                stats.latency[type].record(static_cast<uint64_t>((now - last).count()));
+                last = now;
+            });
+            if (batchLsn > 0) {
+                // A batch whose sync failed was never acknowledged: count it failed.
+                if (!wal->waitDurable(batchLsn)) {
+                    for (size_t t = 0; t < operationTypeCount; ++t) stats.failed[t] += logged[t];
+                }
+                stats.commitWait.record(static_cast<uint64_t>((Clock::now() - last).count()));
+            }
+            if (drained == 0) {
+                if (finished) return;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Applies op and, when logging, sets lsn to its log record's LSN.
+    TransactionStatus execute(const Operation& op, uint64_t& lsn) {
+        if (op.account >= accounts.size()) return TransactionStatus::InvalidAmount;
+        BankAccount& account = *accounts[op.account];
+        WalRecord r;
+        r.timestamp = nowMicros();
+        r.amount = op.amount;
+        r.owner = account.getOwner();
+        switch (op.type) {
+            case OperationType::Deposit: {
+                std::lock_guard<AccountLock> guard(locks[op.account]);
+                TransactionStatus status = account.deposit(op.amount, r.timestamp);
+                r.type = WalRecordType::Deposit;
+                return log(status, r, lsn);
+            }
+            case OperationType::Withdraw: {
+                std::lock_guard<AccountLock> guard(locks[op.account]);
+                TransactionStatus status = account.withdraw(op.amount, r.timestamp);
+                r.type = WalRecordType::Withdrawal;
+                return log(status, r, lsn);
+            }
+            case OperationType::Interest: {
+                std::lock_guard<AccountLock> guard(locks[op.account]);
+                r.amount = account.applyInterest(r.timestamp);
+                r.type = WalRecordType::Interest;
+                return log(TransactionStatus::Ok, r, lsn);
+            }
+            case OperationType::Transfer: {
+                if (op.target >= accounts.size() || op.target == op.account) return TransactionStatus::InvalidAmount;
+                std::lock_guard<AccountLock> first(locks[std::min(op.account, op.target)]);
+                std::lock_guard<AccountLock> second(locks[std::max(op.account, op.target)]);
+                BankAccount& target = *accounts[op.target];
+                TransactionStatus status = account.transferTo(target, op.amount, r.timestamp);
+                r.type = WalRecordType::Transfer;
+                r.target = target.getOwner();
+                return log(status, r, lsn);
+            }
+        }
+        return TransactionStatus::InvalidAmount;
+    }
+
+    TransactionStatus log(TransactionStatus status, const WalRecord& r, uint64_t& lsn) {
+        if (wal && status == TransactionStatus::Ok) lsn = wal->append(r);
+        return status;
+    }
+
+    std::vector<BankAccount*> accounts;
+    std::vector<AccountLock> locks;
+    unsigned workers;
+    WriteAheadLog* wal;
+};
+
+// Replays a random transaction stream against a separate set of simulated
+// accounts and prints the engine's report. With durable set, every change is
+// also written to a scratch write-ahead log that is removed afterwards.
+void runReplaySimulation(uint32_t accountCount, uint64_t transactionCount, unsigned workers, bool durable) {
+    OwnerIndex names;
+    names.reserve(accountCount);
+    std::vector<BankAccount> simulated;
+    simulated.reserve(accountCount);
+    for (uint32_t i = 0; i < accountCount; ++i) simulated.emplace_back(names.insert("sim-" + std::to_string(i), i), 100000);
+    std::vector<BankAccount*> table;
+    for (BankAccount& a : simulated) table.push_back(&a);
+
+    const std::string scratchLog = "bank-replay.wal";
+    std::unique_ptr<WriteAheadLog> wal;
+    if (durable) {
+        std::remove(scratchLog.c_str()); // an interrupted run may have left one; the log only appends
+        wal = std::make_unique<WriteAheadLog>(scratchLog, 0);
+    }
+    TransactionEngine engine(table, workers, wal.get());
+    uint64_t state = 0x243F6A8885A308D3ull;
+    uint64_t produced = 0;
+    EngineReport report = engine.run([&](Operation& op) {
+        if (produced == transactionCount) return false;
+        ++produced;
+        // splitmix64
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        unsigned kind = static_cast<unsigned>(z % 100);
+        op.type = kind < 40 ? OperationType::Deposit
+                : kind < 75 ? OperationType::Withdraw
+                : kind < 98 ? OperationType::Transfer
+                : OperationType::Interest;
+        op.account = static_cast<uint32_t>(((z >> 8) & 0xFFFFFFFF) * accountCount >> 32);
+        op.target = static_cast<uint32_t>((z >> 40) * accountCount >> 24);
+        op.amount = 1 + static_cast<Cents>((z >> 20) % 50000);
+        return true;
+    });
+    report.print();
+    if (durable) {
+        wal.reset();
+        std::remove(scratchLog.c_str());
+    }
+}
+
+#ifdef BANK_X86
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// Four accounts at a time in double lanes, exact because every value stays
+// an integer below 2^53: |balance| < 2^33 cents and |rate| < 2^20 ppm keep
+// balance * rate in range. Lanes outside that fall back to applyRate.
+// Integer <-> double conversion adds and subtracts 1.5 * 2^52, which AVX2
+// can do without the AVX-512 conversion instructions.
+__attribute__((target("avx2"))) Cents avx2CreditInterest(Cents* balances, const RatePpm* rates, Cents* credited,
+                                                           size_t count) {
+    const __m256i magicBits = _mm256_set1_epi64x(0x4338000000000000LL);
+    const __m256d magic = _mm256_castsi256_pd(magicBits);
+    const __m256d million = _mm256_set1_pd(1e6);
+    const __m256d perMillion = _mm256_set1_pd(1e-6);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256i balanceBias = _mm256_set1_epi64x(int64_t(1) << 33);
+    const __m256i balanceHigh = _mm256_set1_epi64x(~((int64_t(1) << 34) - 1));
+    const __m256i rateBias = _mm256_set1_epi64x(int64_t(1) << 20);
+    const __m256i rateHigh = _mm256_set1_epi64x(~((int64_t(1) << 21) - 1));
+    __m256i total = _mm256_setzero_si256();
+    Cents scalarTotal = 0;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i balance = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(balances + i));
+        __m256i rate = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rates + i));
+        // |x| < 2^k exactly when x + 2^k has no bits at or above k + 1.
+        if (!_mm256_testz_si256(_mm256_add_epi64(balance, balanceBias), balanceHigh) ||
+            !_mm256_testz_si256(_mm256_add_epi64(rate, rateBias), rateHigh)) {
+            for (size_t k = i; k < i + 4; ++k) {
+                credited[k] = applyRate(balances[k], rates[k]);
+                balances[k] += credited[k];
+                scalarTotal += credited[k];
+            }
+            continue;
+        }
+
+        __m256d product = _mm256_mul_pd(
+            _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(balance, magicBits)), magic),
+            _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(rate, magicBits)), magic));
+        // The estimate is within one of floor(product / 1e6); the remainder
+        // is exact, so correct the estimate both ways.
+        __m256d quotient = _mm256_floor_pd(_mm256_mul_pd(product, perMillion));
+        __m256d remainder = _mm256_sub_pd(product, _mm256_mul_pd(quotient, million));
+        __m256d low = _mm256_cmp_pd(remainder, zero, _CMP_LT_OQ);
+        quotient = _mm256_sub_pd(quotient, _mm256_and_pd(low, one));
+        remainder = _mm256_add_pd(remainder, _mm256_and_pd(low, million));
+        __m256d high = _mm256_cmp_pd(remainder, million, _CMP_GE_OQ);
+        quotient = _mm256_add_pd(quotient, _mm256_and_pd(high, one));
+        remainder = _mm256_sub_pd(remainder, _mm256_and_pd(high, million));
+
+        // Round half to even.
+        __m256d twice = _mm256_add_pd(remainder, remainder);
+        __m256d halfQuotient = _mm256_mul_pd(quotient, half);
+        __m256d odd = _mm256_cmp_pd(halfQuotient, _mm256_floor_pd(halfQuotient), _CMP_NEQ_OQ);
+        __m256d up = _mm256_or_pd(_mm256_cmp_pd(twice, million, _CMP_GT_OQ),
+                                  _mm256_and_pd(_mm256_cmp_pd(twice, million, _CMP_EQ_OQ), odd));
+        quotient = _mm256_add_pd(quotient, _mm256_and_pd(up, one));
+
+        __m256i interest = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(quotient, magic)), magicBits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(balances + i), _mm256_add_epi64(balance, interest));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(credited + i), interest);
+        total = _mm256_add_epi64(total, interest);
+    }
+    for (; i < count; ++i) {
+        credited[i] = applyRate(balances[i], rates[i]);
+        balances[i] += credited[i];
+        scalarTotal += credited[i];
+    }
+
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return scalarTotal + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+// Credits interest to balances[0, count) and records each credit; returns
+// the total credited.
+Cents creditInterest(Cents* balances, const RatePpm* rates, Cents* credited, size_t count) {
+#ifdef BANK_X86
+    if (hasAvx2()) return avx2CreditInterest(balances, rates, credited, count);
+#endif
+    Cents total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        credited[i] = applyRate(balances[i], rates[i]);
+        balances[i] += credited[i];
+        total += credited[i];
+    }
+    return total;
+}
+
+// Allocator for columns that threads split between them. Storage starts on
+// a cache line, and elements are default-initialized, so a column sized up
+// front is not zeroed only to be overwritten.
+template <class T>
+struct CacheAlignedAllocator {
+    typedef T value_type;
+    static constexpr size_t alignment = 64;
+
+    CacheAlignedAllocator() = default;
+    template <class U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+
+    template <class U>
+    void construct(U* p) {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <class U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template <class T>
+using AlignedColumn = std::vector<T, CacheAlignedAllocator<T>>;
+
+// Accounts stored column by column, for month-end batch work over millions
+// of accounts: the interest kernel streams through the balance and rate
+// columns and touches nothing else.
+class AccountTable {
+public:
+    // One applyInterestAll call. The journal gets a single entry per run
+    // instead of one record per account; credited[id] is what account id
+    // received.
+    struct InterestRun {
+        int64_t timestamp;
+        size_t count;
+        AlignedColumn<Cents> credited;
+    };
+
+    uint32_t add(Cents balance, RatePpm rate) {
+        balances.push_back(balance);
+        rates.push_back(rate);
+        return static_cast<uint32_t>(balances.size() - 1);
+    }
+
+    void reserve(size_t count) {
+        balances.reserve(count);
+        rates.reserve(count);
+    }
+
+    size_t size() const { return balances.size(); }
+    Cents balance(uint32_t id) const { return balances[id]; }
+    RatePpm rate(uint32_t id) const { return rates[id]; }
+    const std::vector<InterestRun>& interestRuns() const { return runs; }
+
+    // Applies interest to every account on up to `workers` threads and
+    // appends the credits to the journal as one run. Returns the total
+    // credited.
+    Cents applyInterestAll(int64_t timestamp, unsigned workers) {
+        size_t count = balances.size();
+        // Left uninitialized; every slot is written by exactly one worker.
+        AlignedColumn<Cents> credited(count);
+
+        // The columns start on cache lines and slices are multiples of 8
+        // eight-byte elements, so workers never write to the same line.
+        const size_t minSlice = 1 << 16;
+        size_t threads = std::max<size_t>(1, std::min<size_t>(workers, count / minSlice));
+        size_t slice = ((count + threads - 1) / threads + 7) & ~size_t(7);
+        std::vector<Cents> totals(threads, 0);
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; ++t) {
+            pool.emplace_back([&, t] { totals[t] = creditSlice(credited.data(), t * slice, slice); });
+        }
+        totals[0] = creditSlice(credited.data(), 0, slice);
+        for (std::thread& th : pool) th.join();
+
+        runs.push_back({ timestamp, count, std::move(credited) });
+        Cents total = 0;
+        for (Cents t : totals) total += t;
+        return total;
+    }
+
+private:
+    Cents creditSlice(Cents* credited, size_t begin, size_t length) {
+        size_t end = std::min(balances.size(), begin + length);
+        if (begin >= end) return 0;
+        return creditInterest(balances.data() + begin, rates.data() + begin, credited + begin, end - begin);
+    }
+
+    AlignedColumn<Cents> balances;
+    AlignedColumn<RatePpm> rates;
+    std::vector<InterestRun> runs;
+};
+
+// Month-end interest for every account in the ledger: the balances and
+// rates are copied into an AccountTable, the batch kernel works out every
+// credit, and the ledger posts them. Sets total to the total credited;
+// false, with no account changed, if the credits could not be logged.
+bool applyMonthEndInterest(Ledger& ledger, unsigned workers, Cents& total) {
+    const std::vector<BankAccount>& accounts = ledger.allAccounts();
+    AccountTable table;
+    table.reserve(accounts.size());
+    for (const BankAccount& account : accounts) table.add(account.getBalance(), account.getInterestRate());
+
+    int64_t timestamp = nowMicros();
+    total = table.applyInterestAll(timestamp, workers);
+    return ledger.postInterest(table.interestRuns().back().credited.data(), timestamp);
+}
+
+// Builds a table of random accounts and times one month-end interest run.
+void runMonthEndSimulation(size_t accountCount, unsigned workers) {
+    AccountTable table;
+    table.reserve(accountCount);
+    uint64_t state = 0x13198A2E03707344ull;
+    for (size_t i = 0; i < accountCount; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        // Up to $10,000 at 0% to 5%.
+        table.add(static_cast<Cents>(state % 1000001), static_cast<RatePpm>((state >> 32) % 50001));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Cents total = table.applyInterestAll(nowMicros(), workers);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Applied interest to " << accountCount << " accounts on " << workers << " thread(s) in "
+              << std::fixed << std::setprecision(1) << seconds * 1000 << " ms ("
+              << accountCount / seconds / 1e6 << " million accounts/s). Total credited: $"
+              << formatCents(total) << "\n";
+    std::cout.unsetf(std::ios::floatfield);
+}
+
 void clearInput() {
     std::cin.clear();
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
-void accountMenu(BankAccount& account) {
+// Reads an amount such as 12.34; returns false (after a message) if it is
+// not a valid amount of money.
+bool readAmount(const std::string& prompt, Cents& amount) {
+    std::cout << prompt;
+    std::string text;
+    std::cin >> text;
+    if (std::cin.fail() || !parseCents(text, amount)) {
+        std::cout << "Invalid amount.\n";
+        clearInput();
+        return false;
+    }
+    return true;
+}
+
+// Reads a first and last date; the range covers both days in full.
+bool readDateRange(int64_t& from, int64_t& to) {
+    std::string first, last;
+    std::cout << "From date (YYYY-MM-DD): ";
+    std::cin >> first;
+    std::cout << "To date (YYYY-MM-DD): ";
+    std::cin >> last;
+    if (std::cin.fail() || !parseDate(first, from) || !parseDate(last, to, 1)) {
+        std::cout << "Invalid date.\n";
+        clearInput();
+        return false;
+    }
+    return true;
+}
+
+void showLastTransactions(const BankAccount& account, size_t n) {
+    const TransactionLog& history = account.getHistory();
+    if (history.empty()) {
+        std::cout << "No transactions yet.\n";
+        return;
+    }
+    for (size_t i = history.size() - std::min(n, history.size()); i < history.size(); ++i) {
+        std::cout << describe(history[i]) << "\n";
+    }
+}
+
+// Lists the range a page at a time; only the records shown are formatted.
+void showTransactionsBetween(const BankAccount& account, int64_t from, int64_t to) {
+    const size_t pageSize = 20;
+    const TransactionLog& history = account.getHistory();
+    size_t begin = history.lowerBound(from);
+    size_t end = std::max(begin, history.lowerBound(to));
+    if (begin == end) {
+        std::cout << "No transactions in that range.\n";
+        return;
+    }
+    std::cout << end - begin << " transaction(s):\n";
+    clearInput();
+    for (size_t i = begin; i < end;) {
+        for (size_t stop = std::min(end, i + pageSize); i < stop; ++i) std::cout << describe(history[i]) << "\n";
+        if (i == end) break;
+        std::cout << "-- " << end - i << " more; Enter to continue, q to stop -- ";
+        std::string reply;
+        if (!std::getline(std::cin, reply) || reply == "q" || reply == "Q") break;
+    }
+}
+
+void showTotalsBetween(const BankAccount& account, int64_t from, int64_t to) {
+    TypeTotals totals = account.getHistory().totals(from, to);
+    Cents net = 0;
+    for (size_t k = 0; k < transactionTypeCount; ++k) {
+        TransactionType type = static_cast<TransactionType>(k);
+        Cents sum = totals.amount[k];
+        net += signedAmount({ 0, sum, type });
+        std::cout << std::left << std::setw(15) << transactionTypeName(type) << std::right << std::setw(8)
+                  << totals.count[k] << "  $" << formatCents(sum) << "\n";
+    }
+    std::cout << "Net change: $" << formatCents(net) << "\n";
+}
+
+void historyMenu(const BankAccount& account) {
+    std::cout << "--- Transaction History for " << account.getOwner() << " ("
+              << account.getHistory().size() << " transactions) ---\n";
+    std::cout << "1. Last N Transactions\n2. Transactions in a Date Range\n3. Totals by Type for a Date Range\n";
+    std::cout << "Choose an option: ";
+    int choice;
+    std::cin >> choice;
+    if (std::cin.fail()) {
+        std::cout << "Invalid input. Please enter a number.\n";
+        clearInput();
+        return;
+    }
+
+    int64_t from, to;
+    if (choice == 1) {
+        size_t n;
+        std::cout << "How many: ";
+        std::cin >> n;
+        if (std::cin.fail()) {
+            std::cout << "Invalid input.\n";
+            clearInput();
+            return;
+        }
+        showLastTransactions(account, n);
+    } else if (choice == 2) {
+        if (readDateRange(from, to)) showTransactionsBetween(account, from, to);
+    } else if (choice == 3) {
+        if (readDateRange(from, to)) showTotalsBetween(account, from, to);
+    } else {
+        std::cout << "Invalid option.\n";
+    }
+}
+
+void accountMenu(Ledger& ledger, BankAccount& account) {
     int choice;
     do {
-        std::cout << "\n--- Account Menu for " << account.checkBalance, account.showTransactionHistory, account.applyInterest, account.withdraw, account.deposit << " ---\n";
+        std::cout << "\n--- Account Menu for " << account.getOwner() << " ---\n";
         std::cout << "1. Deposit\n2. Withdraw\n3. Check Balance\n4. Apply Interest\n5. Show Transaction History\n6. Exit to Main Menu\n";
         std::cout << "Choose an option: ";
         std::cin >> choice;
@@ -83,37 +1750,56 @@ void accountMenu(BankAccount& account) {
 
         switch (choice) {
             case 1: {
-                double amount;
-                std::cout << "Enter amount to deposit: $";
-                std::cin >> amount;
-                if (std::cin.fail()) {
-                    std::cout << "Invalid amount.\n";
-                    clearInput();
+                Cents amount;
+                if (!readAmount("Enter amount to deposit: $", amount)) break;
+                TransactionStatus status = ledger.deposit(account, amount);
+                if (status == TransactionStatus::LogFailed) {
+                    std::cout << "Could not record the deposit; balance unchanged.\n";
                     break;
                 }
-                account.deposit(amount);
+                if (status != TransactionStatus::Ok) {
+                    std::cout << "Deposit amount must be positive.\n";
+                    break;
+                }
+                std::cout << "Deposited $" << formatCents(amount) << ". New balance: $"
+                          << formatCents(account.getBalance()) << "\n";
                 break;
             }
             case 2: {
-                double amount;
-                std::cout << "Enter amount to withdraw: $";
-                std::cin >> amount;
-                if (std::cin.fail()) {
-                    std::cout << "Invalid amount.\n";
-                    clearInput();
+                Cents amount;
+                if (!readAmount("Enter amount to withdraw: $", amount)) break;
+                TransactionStatus status = ledger.withdraw(account, amount);
+                if (status == TransactionStatus::InvalidAmount) {
+                    std::cout << "Withdrawal amount must be positive.\n";
                     break;
                 }
-                account.withdraw(amount);
+                if (status == TransactionStatus::InsufficientFunds) {
+                    std::cout << "Insufficient funds. Withdrawal cancelled.\n";
+                    break;
+                }
+                if (status == TransactionStatus::LogFailed) {
+                    std::cout << "Could not record the withdrawal; balance unchanged.\n";
+                    break;
+                }
+                std::cout << "Withdrew $" << formatCents(amount) << ". New balance: $"
+                          << formatCents(account.getBalance()) << "\n";
                 break;
             }
             case 3:
                 account.checkBalance();
                 break;
-            case 4:
-                account.applyInterest();
+            case 4: {
+                Cents interest;
+                if (!ledger.applyInterest(account, interest)) {
+                    std::cout << "Could not record the interest; balance unchanged.\n";
+                    break;
+                }
+                std::cout << "Interest of $" << formatCents(interest) << " applied. New balance: $"
+                          << formatCents(account.getBalance()) << "\n";
                 break;
+            }
             case 5:
-                account.showTransactionHistory();
+                historyMenu(account);
                 break;
             case 6:
                 std::cout << "Returning to main menu.\n";
@@ -121,16 +1807,17 @@ void accountMenu(BankAccount& account) {
             default:
                 std::cout << "Invalid option. Try again.\n";
         }
+        ledger.snapshotIfDue(); // after the result is shown, not before
     } while (choice != 6);
 }
 
 int main() {
-    std::map<std::string, BankAccount> accounts;
+    Ledger ledger("bank.wal", "bank.snapshot");
 
     int mainChoice;
     do {
         std::cout << "\n--- Main Menu ---\n";
-        std::cout << "1. Create Account\n2. Select Account\n3. Exit\nChoose an option: ";
+        std::cout << "1. Create Account\n2. Select Account\n3. Replay Simulated Transactions\n4. Run Month-End Interest Batch\n5. Exit\nChoose an option: ";
         std::cin >> mainChoice;
 
         if (std::cin.fail()) {
@@ -145,11 +1832,17 @@ int main() {
             clearInput();
             std::getline(std::cin, newName);
 
-            if (accounts.find(newName) != accounts.end()) {
-                std::cout << "Account already exists.\n";
+            if (newName.size() > OwnerIndex::maxNameLength) {
+                std::cout << "Owner name is too long.\n";
             } else {
-                accounts[newName] = BankAccount(newName);
-                std::cout << "Account created for " << newName << ".\n";
+                Ledger::OpenStatus status = ledger.open(newName);
+                if (status == Ledger::OpenStatus::Unavailable) {
+                    std::cout << "Account already exists.\n";
+                } else if (status == Ledger::OpenStatus::LogFailed) {
+                    std::cout << "Could not record the new account; it was not created.\n";
+                } else {
+                    std::cout << "Account created for " << newName << ".\n";
+                }
             }
         } else if (mainChoice == 2) {
             std::string selName;
@@ -157,19 +1850,65 @@ int main() {
             clearInput();
             std::getline(std::cin, selName);
 
-            auto it = accounts.find(selName);
-            if (it == accounts.end()) {
+            BankAccount* account = ledger.find(selName);
+            if (!account) {
                 std::cout << "Account not found.\n";
             } else {
-                accountMenu(it->second);
+                accountMenu(ledger, *account);
             }
         } else if (mainChoice == 3) {
+            uint32_t accountCount;
+            uint64_t transactionCount;
+            unsigned workers;
+            std::cout << "Number of simulated accounts: ";
+            std::cin >> accountCount;
+            std::cout << "Number of transactions: ";
+            std::cin >> transactionCount;
+            std::cout << "Worker threads (0 = one per core): ";
+            std::cin >> workers;
+            char durable;
+            std::cout << "Write a write-ahead log? (y/n): ";
+            std::cin >> durable;
+            if (std::cin.fail() || accountCount < 2) {
+                std::cout << "Invalid input.\n";
+                clearInput();
+                continue;
+            }
+            if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+            runReplaySimulation(accountCount, transactionCount, workers, durable == 'y' || durable == 'Y');
+        } else if (mainChoice == 4) {
+            size_t accountCount;
+            unsigned workers;
+            std::cout << "Number of simulated accounts (0 = this bank's accounts): ";
+            std::cin >> accountCount;
+            std::cout << "Worker threads (0 = one per core): ";
+            std::cin >> workers;
+            if (std::cin.fail()) {
+                std::cout << "Invalid input.\n";
+                clearInput();
+                continue;
+            }
+            if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+            if (accountCount == 0) {
+                Cents total;
+                if (!applyMonthEndInterest(ledger, workers, total)) {
+                    std::cout << "Could not record the interest; no account was changed.\n";
+                } else {
+                    std::cout << "Applied interest to " << ledger.allAccounts().size()
+                              << " account(s). Total credited: $" << formatCents(total) << "\n";
+                }
+            } else {
+                runMonthEndSimulation(accountCount, workers);
+            }
+        } else if (mainChoice == 5) {
+            ledger.snapshot();
             std::cout << "Exiting program. Goodbye!\n";
         } else {
             std::cout << "Invalid option. Try again.\n";
         }
+        ledger.snapshotIfDue();
 
-    } while (mainChoice != 3);
+    } while (mainChoice != 5);
 
     return 0;
 }
@@ -1,9 +1,309 @@
 #include <iostream>
 #include <cstdlib>
+#include <cmath>
 #include <ctime>
 #include <vector>
 #include <string>
 #include <limits>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <fstream>
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RPG_X86 1
+#endif
+
+// xoshiro256** seeded through splitmix64. Every random roll in a battle
+// comes from the Rng its characters point at, so a simulation that gives
+// each battle its own seeded Rng replays exactly on any thread.
+class Rng {
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    explicit Rng(uint64_t seed = 1) {
+        reseed(seed);
+    }
+
+    void reseed(uint64_t seed) {
+        for (uint64_t& word : s) {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    uint64_t stateWord(int i) const {
+        return s[i];
+    }
+
+    // Uniform in [0, n) for 0 < n < 2^31, by multiply-shift instead of %.
+    int below(int n) {
+        return static_cast<int>(((next() >> 32) * static_cast<uint64_t>(n)) >> 32);
+    }
+};
+
+// Rng used by interactive play; main seeds it from the clock.
+Rng& sharedRng() {
+    static Rng rng;
+    return rng;
+}
+
+// ---- Replays ----
+
+// Binary record of one interactive session: the seed of the shared Rng,
+// then every value the player entered and a checkpoint hash after each
+// battle turn, as tagged events. Ints are zigzag varints, so a typical
+// turn costs about six bytes.
+//
+// File layout: "RPGR", version byte, seed (8 bytes little-endian), events.
+class Replay {
+public:
+    enum Tag : uint8_t { IntValue = 1, BadInt = 2, CharValue = 3, TextValue = 4, Checkpoint = 5 };
+
+    uint64_t seed = 0;
+    std::string events;
+
+    void putTag(Tag tag) {
+        events.push_back(static_cast<char>(tag));
+    }
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            events.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        events.push_back(static_cast<char>(value));
+    }
+
+    void putInt(int value) {
+        putTag(IntValue);
+        putVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63));
+    }
+
+    void putText(const std::string& text) {
+        putTag(TextValue);
+        putVarint(text.size());
+        events += text;
+    }
+
+    void putChar(char c) {
+        putTag(CharValue);
+        events.push_back(c);
+    }
+
+    void putCheckpoint(uint32_t hash) {
+        putTag(Checkpoint);
+        for (int i = 0; i < 4; ++i) events.push_back(static_cast<char>(hash >> (8 * i)));
+    }
+
+    // Readers advance pos and return false at the end of the events or on
+    // a truncated value.
+    bool getByte(size_t& pos, uint8_t& byte) const {
+        if (pos >= events.size()) return false;
+        byte = static_cast<uint8_t>(events[pos++]);
+        return true;
+    }
+
+    bool getVarint(size_t& pos, uint64_t& value) const {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!getByte(pos, byte)) return false;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        char header[13] = { 'R', 'P', 'G', 'R', 1 };
+        for (int i = 0; i < 8; ++i) header[5 + i] = static_cast<char>(seed >> (8 * i));
+        out.write(header, sizeof(header));
+        out.write(events.data(), static_cast<std::streamsize>(events.size()));
+        return static_cast<bool>(out.flush());
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        char header[13];
+        if (!in.read(header, sizeof(header)) || std::string(header, 4) != "RPGR" || header[4] != 1) return false;
+        seed = 0;
+        for (int i = 0; i < 8; ++i) seed |= static_cast<uint64_t>(static_cast<uint8_t>(header[5 + i])) << (8 * i);
+        events.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+};
+
+// Where an interactive session gets the player's input. A live session
+// reads std::cin and can record every value into a Replay; a replayed one
+// reads the Replay instead and compares its checkpoints with the game's.
+class GameInput {
+    Replay* recording = nullptr;
+    const Replay* playback = nullptr;
+    size_t cursor = 0;
+    bool ended = false;
+    size_t checkpoints = 0;
+    size_t divergedAt = 0; // first checkpoint that did not match, 1-based; 0 = none
+
+    // Next event in playback, which must carry the given tag.
+    bool expect(Replay::Tag tag) {
+        uint8_t found;
+        if (ended || !playback->getByte(cursor, found)) {
+            ended = true;
+            return false;
+        }
+        if (found != tag) {
+            divergedAt = checkpoints + 1;
+            ended = true;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    GameInput(Replay* recording = nullptr) : recording(recording) {}
+
+    explicit GameInput(const Replay& replay) : playback(&replay) {}
+
+    // Reads a whole number. Returns false for input that is not one, and
+    // also once the input has run out (see finished()).
+    bool readInt(int& value) {
+        if (playback) {
+            uint8_t tag;
+            size_t at = cursor;
+            if (ended || !playback->getByte(at, tag)) {
+                ended = true;
+                return false;
+            }
+            if (tag == Replay::BadInt) {
+                cursor = at;
+                return false;
+            }
+            uint64_t zigzag;
+            if (!expect(Replay::IntValue) || !playback->getVarint(cursor, zigzag)) {
+                ended = true;
+                return false;
+            }
+            value = static_cast<int>(static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1));
+            return true;
+        }
+        if (std::cin >> value) {
+            if (recording) recording->putInt(value);
+            return true;
+        }
+        if (std::cin.eof()) {
+            ended = true;
+            return false;
+        }
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        if (recording) recording->putTag(Replay::BadInt);
+        return false;
+    }
+
+    // Reads one non-blank character and drops the rest of the line.
+    char readChar() {
+        if (playback) {
+            uint8_t c;
+            if (!expect(Replay::CharValue) || !playback->getByte(cursor, c)) return '\0';
+            return static_cast<char>(c);
+        }
+        char c;
+        if (!(std::cin >> c)) {
+            ended = true;
+            return '\0';
+        }
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        if (recording) recording->putChar(c);
+        return c;
+    }
+
+    // Reads a line, skipping blank ones.
+    std::string readLine() {
+        std::string line;
+        if (playback) {
+            uint64_t length;
+            if (!expect(Replay::TextValue) || !playback->getVarint(cursor, length) ||
+                length > playback->events.size() - cursor) {
+                ended = true;
+                return line;
+            }
+            line = playback->events.substr(cursor, length);
+            cursor += length;
+            return line;
+        }
+        if (!std::getline(std::cin >> std::ws, line)) ended = true;
+        if (recording) recording->putText(line);
+        return line;
+    }
+
+    // Called by the game after every battle turn with a hash of its state:
+    // recorded live, checked against the recording in playback. Playback
+    // stops at the first mismatch, since everything after it is suspect.
+    void checkpoint(uint64_t state) {
+        uint32_t hash = static_cast<uint32_t>(state ^ (state >> 32));
+        ++checkpoints;
+        if (recording) recording->putCheckpoint(hash);
+        if (!playback) return;
+        uint32_t expected = 0;
+        uint8_t byte;
+        bool read = expect(Replay::Checkpoint);
+        for (int i = 0; read && i < 4; ++i) {
+            read = playback->getByte(cursor, byte);
+            expected |= static_cast<uint32_t>(byte) << (8 * i);
+        }
+        if (!read || expected != hash) {
+            if (!divergedAt) divergedAt = checkpoints;
+            ended = true;
+        }
+    }
+
+    // True once the input is used up: end of std::cin, end of the replay,
+    // or a replay that stopped matching.
+    bool finished() const {
+        return ended;
+    }
+
+    size_t checkpointCount() const {
+        return checkpoints;
+    }
+
+    // Playback only: the first checkpoint that differed, or 0. A session
+    // that finished without reading the whole replay also counts, at the
+    // checkpoint after the last one it reached.
+    size_t divergence() const {
+        if (divergedAt) return divergedAt;
+        return playback && cursor < playback->events.size() ? checkpoints + 1 : 0;
+    }
+};
 
 // Base Character class
 class Character {
@@ -12,16 +312,32 @@ protected:
     int health;
     int maxHealth;
     int attackPower;
+    int speed;                      // initiative; see InitiativeQueue
+    std::ostream* log = &std::cout; // battle narration; nullptr keeps a battle silent
+    Rng* rng = &sharedRng();        // source of every roll this character makes
 public:
-    Character(std::string name, int health, int attackPower)
-        : name(name), health(health), maxHealth(health), attackPower(attackPower) {}
+    Character(std::string name, int health, int attackPower, int speed = 10)
+        : name(name), health(health), maxHealth(health), attackPower(attackPower), speed(speed) {}
 
     virtual ~Character() {}
 
+    void setName(std::string newName) {
+        name = newName;
+    }
+
+    void setLog(std::ostream* out) {
+        log = out;
+    }
+
+    void setRng(Rng* source) {
+        rng = source;
+    }
+
     virtual void attack(Character& target) {
-        int damage = rand() % attackPower + 1; // 1 to attackPower
-        std::cout << name << " attacks " << target.getName()
-                  << " for " << damage << " damage!\n";
+        int damage = rng->below(attackPower) + 1; // 1 to attackPower
+        if (log)
+            *log << name << " attacks " << target.getName()
+                 << " for " << damage << " damage!\n";
         target.takeDamage(damage);
     }
 
@@ -42,10 +358,18 @@ public:
         return health;
     }
 
+    int getAttackPower() const {
+        return attackPower;
+    }
+
     int getMaxHealth() const {
         return maxHealth;
     }
 
+    int getSpeed() const {
+        return speed;
+    }
+
     virtual void showStats() const {
         std::cout << name << " HP: " << health << "/" << maxHealth << "\n";
     }
@@ -62,48 +386,82 @@ struct Item {
 
 enum class PlayerClass { Warrior, Mage, Archer };
 
+const int classCount = 3;
+const int enemyKinds = 3;
+
+// Every number the game is balanced by. The defaults are the hand-tuned
+// values; --balance searches for others.
+struct BalanceConfig {
+    struct ClassStats {
+        int health;
+        int attack;
+        int potionHeal;
+        int weaponPower;
+        int armorPower;
+        int speed;
+    };
+    struct EnemyStats {
+        int health;
+        int attack;
+        int xpReward;
+        int speed;
+    };
+
+    ClassStats classes[classCount] = {
+        { 120, 20, 50, 8, 5, 10 },  // Warrior
+        { 90, 15, 30, 10, 2, 10 },  // Mage
+        { 100, 18, 40, 9, 3, 12 },  // Archer
+    };
+    EnemyStats enemies[enemyKinds] = {
+        { 60, 15, 50, 12 },   // Goblin
+        { 90, 20, 80, 9 },    // Orc
+        { 150, 30, 200, 8 },  // Dragon
+    };
+};
+
+const BalanceConfig& defaultBalance() {
+    static const BalanceConfig balance;
+    return balance;
+}
+
 class Player : public Character {
     PlayerClass playerClass;
     int level;
     int experience;
 
-    // Equipment slots
-    Item* equippedWeapon;
-    Item* equippedArmor;
+    // Equipment slots, held by value so copies and destruction need no care
+    std::optional<Item> equippedWeapon;
+    std::optional<Item> equippedArmor;
 
     std::vector<Item> inventory;
 
 public:
-    Player(std::string name, PlayerClass pclass)
+    Player(std::string name, PlayerClass pclass, const BalanceConfig& balance = defaultBalance())
         : Character(name, 100, 15),
           playerClass(pclass),
           level(1),
-          experience(0),
-          equippedWeapon(nullptr),
-          equippedArmor(nullptr) 
+          experience(0)
     {
         // Initialize stats & inventory based on class
+        const BalanceConfig::ClassStats& stats = balance.classes[static_cast<int>(pclass)];
+        maxHealth = health = stats.health;
+        attackPower = stats.attack;
+        speed = stats.speed;
         switch (playerClass) {
             case PlayerClass::Warrior:
-                maxHealth = health = 120;
-                attackPower = 20;
-                inventory.push_back(Item(Item::Potion, "Health Potion", 50));
-                inventory.push_back(Item(Item::Weapon, "Iron Sword", 8));
-                inventory.push_back(Item(Item::Armor, "Steel Armor", 5));
+                inventory.push_back(Item(Item::Potion, "Health Potion", stats.potionHeal));
+                inventory.push_back(Item(Item::Weapon, "Iron Sword", stats.weaponPower));
+                inventory.push_back(Item(Item::Armor, "Steel Armor", stats.armorPower));
                 break;
             case PlayerClass::Mage:
-                maxHealth = health = 90;
-                attackPower = 15;
-                inventory.push_back(Item(Item::Potion, "Mana Potion", 30)); // treat as healing for now
-                inventory.push_back(Item(Item::Weapon, "Magic Staff", 10));
-                inventory.push_back(Item(Item::Armor, "Robes", 2));
+                inventory.push_back(Item(Item::Potion, "Mana Potion", stats.potionHeal)); // treat as healing for now
+                inventory.push_back(Item(Item::Weapon, "Magic Staff", stats.weaponPower));
+                inventory.push_back(Item(Item::Armor, "Robes", stats.armorPower));
                 break;
             case PlayerClass::Archer:
-                maxHealth = health = 100;
-                attackPower = 18;
-                inventory.push_back(Item(Item::Potion, "Health Potion", 40));
-                inventory.push_back(Item(Item::Weapon, "Longbow", 9));
-                inventory.push_back(Item(Item::Armor, "Leather Armor", 3));
+                inventory.push_back(Item(Item::Potion, "Health Potion", stats.potionHeal));
+                inventory.push_back(Item(Item::Weapon, "Longbow", stats.weaponPower));
+                inventory.push_back(Item(Item::Armor, "Leather Armor", stats.armorPower));
                 break;
         }
     }
@@ -111,14 +469,11 @@ public:
     // Override attack to include weapon bonus
     void attack(Character& target) override {
         int weaponBonus = (equippedWeapon ? equippedWeapon->power : 0);
-        int damage = rand() % attackPower + 1 + weaponBonus;
-        std::cout << name << " (" << getClassName() << ") attacks " << target.getName()
-                  << " with ";
-        if (equippedWeapon)
-            std::cout << equippedWeapon->name;
-        else
-            std::cout << "fists";
-        std::cout << " for " << damage << " damage!\n";
+        int damage = rng->below(attackPower) + 1 + weaponBonus;
+        if (log)
+            *log << name << " (" << getClassName() << ") attacks " << target.getName()
+                 << " with " << (equippedWeapon ? equippedWeapon->name : "fists")
+                 << " for " << damage << " damage!\n";
         target.takeDamage(damage);
     }
 
@@ -127,8 +482,9 @@ public:
         int armorDefense = (equippedArmor ? equippedArmor->power : 0);
         int reducedDamage = amount - armorDefense;
         if (reducedDamage < 0) reducedDamage = 0;
-        std::cout << name << "'s armor reduces damage by " << armorDefense
-                  << ". Damage taken: " << reducedDamage << "\n";
+        if (log)
+            *log << name << "'s armor reduces damage by " << armorDefense
+                 << ". Damage taken: " << reducedDamage << "\n";
         health -= reducedDamage;
         if (health < 0) health = 0;
     }
@@ -139,12 +495,20 @@ public:
                 int healAmount = inventory[i].power;
                 health += healAmount;
                 if (health > maxHealth) health = maxHealth;
-                std::cout << name << " uses " << inventory[i].name << " and heals " << healAmount << " HP!\n";
+                if (log)
+                    *log << name << " uses " << inventory[i].name << " and heals " << healAmount << " HP!\n";
                 inventory.erase(inventory.begin() + i);
                 return;
             }
         }
-        std::cout << "No potions left in inventory!\n";
+        if (log) *log << "No potions left in inventory!\n";
+    }
+
+    bool hasPotion() const {
+        for (const Item& item : inventory) {
+            if (item.type == Item::Potion) return true;
+        }
+        return false;
     }
 
     void showInventory() const {
@@ -176,58 +540,71 @@ public:
     }
 
     // Equip weapon or armor from inventory
-    void equipItem() {
+    void equipItem(GameInput& input) {
         if (inventory.empty()) {
             std::cout << "Inventory is empty. Nothing to equip.\n";
             return;
         }
         showInventory();
         std::cout << "Enter the number of the item to equip (weapon or armor), or 0 to cancel: ";
-        int choice;
-        std::cin >> choice;
+        int choice = 0;
+        input.readInt(choice);
         if (choice <= 0 || choice > (int)inventory.size()) {
             std::cout << "Equip cancelled.\n";
             return;
         }
-        Item& item = inventory[choice - 1];
+        if (!equip(choice - 1)) {
+            std::cout << "Cannot equip that item.\n";
+        }
+    }
+
+    // Equips inventory[index] if it is a weapon or armor.
+    bool equip(size_t index) {
+        Item& item = inventory[index];
         if (item.type == Item::Weapon) {
             if (equippedWeapon) {
-                std::cout << "Unequipped " << equippedWeapon->name << " and returned to inventory.\n";
+                if (log) *log << "Unequipped " << equippedWeapon->name << " and returned to inventory.\n";
                 inventory.push_back(*equippedWeapon);
             }
-            equippedWeapon = new Item(item);
-            std::cout << "Equipped weapon: " << equippedWeapon->name << "\n";
-            inventory.erase(inventory.begin() + (choice - 1));
+            equippedWeapon = inventory[index];
+            if (log) *log << "Equipped weapon: " << equippedWeapon->name << "\n";
+            inventory.erase(inventory.begin() + index);
+            return true;
         }
-        else if (item.type == Item::Armor) {
+        if (item.type == Item::Armor) {
             if (equippedArmor) {
-                std::cout << "Unequipped " << equippedArmor->name << " and returned to inventory.\n";
+                if (log) *log << "Unequipped " << equippedArmor->name << " and returned to inventory.\n";
                 inventory.push_back(*equippedArmor);
             }
-            equippedArmor = new Item(item);
-            std::cout << "Equipped armor: " << equippedArmor->name << "\n";
-            inventory.erase(inventory.begin() + (choice - 1));
+            equippedArmor = inventory[index];
+            if (log) *log << "Equipped armor: " << equippedArmor->name << "\n";
+            inventory.erase(inventory.begin() + index);
+            return true;
         }
-        else {
-            std::cout << "Cannot equip that item.\n";
+        return false;
+    }
+
+    // Equips every weapon and armor piece in the inventory, as a scripted
+    // player would before its first fight.
+    void equipStartingGear() {
+        for (size_t i = 0; i < inventory.size();) {
+            if (!equip(i)) ++i;
         }
     }
 
-    void unequipItem() {
+    void unequipItem(GameInput& input) {
         std::cout << "Unequip:\n1. Weapon\n2. Armor\nChoose 0 to cancel: ";
-        int choice;
-        std::cin >> choice;
+        int choice = -1;
+        input.readInt(choice);
         if (choice == 1 && equippedWeapon) {
             inventory.push_back(*equippedWeapon);
             std::cout << "Unequipped " << equippedWeapon->name << " and returned to inventory.\n";
-            delete equippedWeapon;
-            equippedWeapon = nullptr;
+            equippedWeapon.reset();
         }
         else if (choice == 2 && equippedArmor) {
             inventory.push_back(*equippedArmor);
             std::cout << "Unequipped " << equippedArmor->name << " and returned to inventory.\n";
-            delete equippedArmor;
-            equippedArmor = nullptr;
+            equippedArmor.reset();
         }
         else if (choice == 0) {
             std::cout << "Unequip cancelled.\n";
@@ -259,10 +636,35 @@ public:
         return level;
     }
 
+    int getExperience() const {
+        return experience;
+    }
+
+    const std::vector<Item>& getInventory() const {
+        return inventory;
+    }
+
     PlayerClass getClass() const {
         return playerClass;
     }
 
+    int getWeaponBonus() const {
+        return equippedWeapon ? equippedWeapon->power : 0;
+    }
+
+    int getArmorDefense() const {
+        return equippedArmor ? equippedArmor->power : 0;
+    }
+
+    // Heal amounts of the carried potions in the order usePotion drinks them.
+    std::vector<int> getPotionHeals() const {
+        std::vector<int> heals;
+        for (const Item& item : inventory) {
+            if (item.type == Item::Potion) heals.push_back(item.power);
+        }
+        return heals;
+    }
+
     std::string getClassName() const {
         switch (playerClass) {
             case PlayerClass::Warrior: return "Warrior";
@@ -283,6 +685,11 @@ public:
         std::cout << "Experience: " << experience << "/" << level * 100 << "\n";
     }
 
+    // Health the special ability costs its user.
+    int getSpecialCost() const {
+        return playerClass == PlayerClass::Warrior ? berserkRecoil : 0;
+    }
+
     // Special ability per class
     void specialAbility(Character& target) {
         switch (playerClass) {
@@ -299,22 +706,24 @@ public:
     }
 
 private:
+    static constexpr int berserkRecoil = 5;
+
     void warriorBerserk(Character& target) {
         int weaponBonus = (equippedWeapon ? equippedWeapon->power : 0);
-        int damage = (rand() % (attackPower + 10)) + weaponBonus + 10;
-        std::cout << name << " uses Berserk and deals " << damage << " massive damage to " << target.getName() << "!\n";
+        int damage = rng->below(attackPower + 10) + weaponBonus + 10;
+        if (log) *log << name << " uses Berserk and deals " << damage << " massive damage to " << target.getName() << "!\n";
         target.takeDamage(damage);
-        int recoil = 5;
-        health -= recoil;
+        health -= berserkRecoil;
         if (health < 0) health = 0;
-        std::cout << name << " suffers " << recoil << " recoil damage.\n";
+        if (log) *log << name << " suffers " << berserkRecoil << " recoil damage.\n";
     }
 
     void mageFireball(Character& target) {
         int weaponBonus = (equippedWeapon ? equippedWeapon->power : 0);
-        int damage = (rand() % (attackPower + 15)) + weaponBonus + 5;
-        std::cout << name << " casts Fireball and burns " << target.getName()
-                  << " for " << damage << " damage!\n";
+        int damage = rng->below(attackPower + 15) + weaponBonus + 5;
+        if (log)
+            *log << name << " casts Fireball and burns " << target.getName()
+                 << " for " << damage << " damage!\n";
         target.takeDamage(damage);
     }
 
@@ -322,15 +731,15 @@ private:
         int weaponBonus = (equippedWeapon ? equippedWeapon->power : 0);
         int shots = 3;
         int totalDamage = 0;
-        std::cout << name << " fires Rapid Shots!\n";
+        if (log) *log << name << " fires Rapid Shots!\n";
         for (int i = 0; i < shots; ++i) {
-            int damage = (rand() % attackPower) + weaponBonus / 2 + 3;
-            std::cout << "Shot " << (i + 1) << " deals " << damage << " damage.\n";
+            int damage = rng->below(attackPower) + weaponBonus / 2 + 3;
+            if (log) *log << "Shot " << (i + 1) << " deals " << damage << " damage.\n";
             target.takeDamage(damage);
             totalDamage += damage;
             if (!target.isAlive()) break;
         }
-        std::cout << "Total Rapid Shot damage: " << totalDamage << "\n";
+        if (log) *log << "Total Rapid Shot damage: " << totalDamage << "\n";
     }
 };
 
@@ -338,8 +747,8 @@ private:
 class Enemy : public Character {
     int experienceReward;
 public:
-    Enemy(std::string name, int health, int attackPower, int xpReward)
-        : Character(name, health, attackPower), experienceReward(xpReward) {}
+    Enemy(std::string name, int health, int attackPower, int xpReward, int speed = 10)
+        : Character(name, health, attackPower, speed), experienceReward(xpReward) {}
 
     int getExperienceReward() const { return experienceReward; }
 
@@ -348,14 +757,84 @@ public:
     }
 };
 
-Enemy generateRandomEnemy() {
-    int choice = rand() % 3;
-    switch (choice) {
-        case 0: return Enemy("Goblin", 60, 15, 50);
-        case 1: return Enemy("Orc", 90, 20, 80);
-        case 2: return Enemy("Dragon", 150, 30, 200);
+const char* const enemyNames[enemyKinds] = { "Goblin", "Orc", "Dragon" };
+const int packSizes[enemyKinds] = { 3, 2, 1 }; // most of each kind that attack together
+
+Enemy makeEnemy(int kind, const BalanceConfig& balance = defaultBalance()) {
+    if (kind < 0 || kind >= enemyKinds) kind = 0; // fallback
+    const BalanceConfig::EnemyStats& stats = balance.enemies[kind];
+    return Enemy(enemyNames[kind], stats.health, stats.attack, stats.xpReward, stats.speed);
+}
+
+// A random kind of enemy, alone or in a pack.
+std::vector<Enemy> generateRandomEnemies() {
+    int kind = sharedRng().below(enemyKinds);
+    int count = sharedRng().below(packSizes[kind]) + 1;
+    std::vector<Enemy> enemies;
+    for (int i = 0; i < count; ++i) {
+        enemies.push_back(makeEnemy(kind));
+        if (count > 1) enemies.back().setName(enemies.back().getName() + " " + std::to_string(i + 1));
     }
-    return Enemy("Goblin", 60, 15, 50); // fallback
+    return enemies;
+}
+
+// Turn order for a battle between any number of combatants, identified by
+// index. A combatant with speed s acts every initiativeScale / s ticks, so
+// one twice as fast acts twice as often; ties go to the lower index.
+const int64_t initiativeScale = 720720; // divisible by every speed up to 16
+
+class InitiativeQueue {
+public:
+    struct Turn {
+        int64_t time;
+        int unit;
+
+        bool operator>(const Turn& other) const {
+            return time != other.time ? time > other.time : unit > other.unit;
+        }
+    };
+
+    // Queues unit's next turn, one interval after now.
+    void schedule(int unit, int speed, int64_t now) {
+        turns.push({ now + initiativeScale / std::max(1, speed), unit });
+    }
+
+    bool empty() const {
+        return turns.empty();
+    }
+
+    const Turn& peek() const {
+        return turns.top();
+    }
+
+    Turn pop() {
+        Turn turn = turns.top();
+        turns.pop();
+        return turn;
+    }
+
+private:
+    std::priority_queue<Turn, std::vector<Turn>, std::greater<Turn>> turns;
+};
+
+// Hash of everything a battle turn can change, including the shared Rng,
+// for replay checkpoints.
+uint64_t stateChecksum(const Player& player, const std::vector<Enemy>& enemies) {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a over 64-bit words
+    auto fold = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 1099511628211ULL;
+    };
+    fold(player.getHealth());
+    fold(player.getMaxHealth());
+    fold(player.getAttackPower());
+    fold(player.getLevel());
+    fold(player.getExperience());
+    fold(player.getWeaponBonus());
+    fold(player.getArmorDefense());
+    for (const Item& item : player.getInventory()) fold((static_cast<uint64_t>(item.type) << 32) ^ item.power);
+    for (const Enemy& enemy : enemies) fold(enemy.getHealth());
+    for (int i = 0; i < 4; ++i) fold(sharedRng().stateWord(i));
+    return hash;
 }
 
 // ASCII art for UI enhancement
@@ -371,89 +850,1303 @@ void printTitle() {
     std::cout << "Welcome to the ASCII RPG Battle!\n\n";
 }
 
-void printBattleBanner(const std::string& enemyName) {
-    std::cout << "\n=== A wild " << enemyName << " appears! ===\n";
+void printBattleBanner(const std::vector<Enemy>& enemies) {
+    if (enemies.size() == 1) {
+        std::cout << "\n=== A wild " << enemies[0].getName() << " appears! ===\n";
+        return;
+    }
+    std::cout << "\n=== " << enemies.size() << " wild enemies appear: ";
+    for (size_t i = 0; i < enemies.size(); ++i) {
+        std::cout << (i ? ", " : "") << enemies[i].getName();
+    }
+    std::cout << "! ===\n";
+}
+
+bool anyAlive(const std::vector<Enemy>& enemies) {
+    for (const Enemy& enemy : enemies) {
+        if (enemy.isAlive()) return true;
+    }
+    return false;
 }
 
-void battle(Player& player, Enemy& enemy) {
-    printBattleBanner(enemy.getName());
-    while (player.isAlive() && enemy.isAlive()) {
-        std::cout << "\n--- Battle Menu ---\n";
-        std::cout << "1. Attack\n";
-        std::cout << "2. Defend (Heal)\n";
-        std::cout << "3. Use Potion\n";
-        std::cout << "4. Special Ability\n";
-        std::cout << "5. Show Inventory\n";
-        std::cout << "6. Equip Item\n";
-        std::cout << "7. Unequip Item\n";
-        std::cout << "Choose your action: ";
-
-        int choice;
-        std::cin >> choice;
-
-        if (std::cin.fail()) {
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            std::cout << "Invalid input. Try again.\n";
+// Asks which enemy to strike when more than one is still standing.
+Enemy& chooseTarget(std::vector<Enemy>& enemies, GameInput& input) {
+    std::vector<Enemy*> standing;
+    for (Enemy& enemy : enemies) {
+        if (enemy.isAlive()) standing.push_back(&enemy);
+    }
+    if (standing.size() == 1) return *standing[0];
+
+    std::cout << "Choose your target:\n";
+    for (size_t i = 0; i < standing.size(); ++i) {
+        std::cout << (i + 1) << ". " << standing[i]->getName() << " (HP: " << standing[i]->getHealth() << ")\n";
+    }
+    int choice = 0;
+    if (!input.readInt(choice) || choice < 1 || choice > static_cast<int>(standing.size())) {
+        if (!input.finished()) std::cout << "Invalid target, attacking " << standing[0]->getName() << ".\n";
+        choice = 1;
+    }
+    return *standing[choice - 1];
+}
+
+// Fights the player against a group of enemies. Turns come from an
+// InitiativeQueue: combatant 0 is the player, 1..n the enemies. Showing or
+// changing equipment does not use up the player's turn.
+void battle(Player& player, std::vector<Enemy>& enemies, GameInput& input) {
+    printBattleBanner(enemies);
+    InitiativeQueue order;
+    order.schedule(0, player.getSpeed(), 0);
+    for (size_t i = 0; i < enemies.size(); ++i) {
+        order.schedule(static_cast<int>(i + 1), enemies[i].getSpeed(), 0);
+    }
+
+    while (player.isAlive() && anyAlive(enemies)) {
+        InitiativeQueue::Turn turn = order.pop();
+        if (turn.unit > 0) {
+            Enemy& enemy = enemies[turn.unit - 1];
+            if (!enemy.isAlive()) continue; // fallen enemies leave the order
+            enemy.attack(player);
+            order.schedule(turn.unit, enemy.getSpeed(), turn.time);
+            input.checkpoint(stateChecksum(player, enemies));
             continue;
         }
 
-        switch (choice) {
-            case 1:
+        std::cout << "\nStatus:\n";
+        player.showStats();
+        for (const Enemy& enemy : enemies) {
+            if (enemy.isAlive()) enemy.showStats();
+        }
+
+        bool acted = false;
+        while (!acted) {
+            std::cout << "\n--- Battle Menu ---\n";
+            std::cout << "1. Attack\n";
+            std::cout << "2. Defend (Heal)\n";
+            std::cout << "3. Use Potion\n";
+            std::cout << "4. Special Ability\n";
+            std::cout << "5. Show Inventory\n";
+            std::cout << "6. Equip Item\n";
+            std::cout << "7. Unequip Item\n";
+            std::cout << "Choose your action: ";
+
+            int choice;
+            if (!input.readInt(choice)) {
+                if (input.finished()) return;
+                std::cout << "Invalid input. Try again.\n";
+                continue;
+            }
+
+            switch (choice) {
+                case 1:
+                    player.attack(chooseTarget(enemies, input));
+                    break;
+                case 2: {
+                    int heal = sharedRng().below(10) + 5;
+                    player.takeDamage(-heal); // heal
+                    if (player.getHealth() > player.getMaxHealth())
+                        player.takeDamage(player.getHealth() - player.getMaxHealth());
+                    std::cout << player.getName() << " defends and heals " << heal << " HP!\n";
+                    break;
+                }
+                case 3:
+                    player.usePotion();
+                    break;
+                case 4:
+                    player.specialAbility(chooseTarget(enemies, input));
+                    break;
+                case 5:
+                    player.showInventory();
+                    continue; // looking does not cost a turn
+                case 6:
+                    player.equipItem(input);
+                    continue;
+                case 7:
+                    player.unequipItem(input);
+                    continue;
+                default:
+                    std::cout << "Invalid choice.\n";
+                    continue;
+            }
+            acted = true;
+        }
+        if (input.finished()) return;
+        order.schedule(0, player.getSpeed(), turn.time);
+        input.checkpoint(stateChecksum(player, enemies));
+    }
+
+    if (player.isAlive()) {
+        int reward = 0;
+        for (const Enemy& enemy : enemies) reward += enemy.getExperienceReward();
+        std::cout << "\nYou defeated " << (enemies.size() == 1 ? enemies[0].getName() : "every enemy") << "!\n";
+        player.gainExperience(reward);
+    } else {
+        std::cout << "\nYou were defeated by " << (enemies.size() == 1 ? enemies[0].getName() : "the pack") << "...\n";
+    }
+    input.checkpoint(stateChecksum(player, enemies));
+}
+
+// ---- Headless simulation ----
+
+// Scripted player behaviour for headless battles.
+struct BattlePolicy {
+    std::string name;
+    bool useSpecial;        // special ability whenever it cannot kill the player
+    int potionBelowPercent; // drink a potion below this share of max HP; 0 = never
+};
+
+enum class BattleAction { Attack, Special, Potion };
+
+BattleAction chooseAction(const BattlePolicy& policy, const Player& player) {
+    if (player.hasPotion() && player.getHealth() * 100 < player.getMaxHealth() * policy.potionBelowPercent)
+        return BattleAction::Potion;
+    if (policy.useSpecial && player.getHealth() > player.getSpecialCost())
+        return BattleAction::Special;
+    return BattleAction::Attack;
+}
+
+// Counts of small non-negative values; anything above maxValue lands in the
+// last bucket.
+template <int maxValue>
+struct Histogram {
+    unsigned long long counts[maxValue + 1] = {};
+    unsigned long long total = 0;
+    unsigned long long sum = 0;
+
+    void add(int value) {
+        ++counts[value < maxValue ? value : maxValue];
+        ++total;
+        sum += value;
+    }
+
+    void merge(const Histogram& other) {
+        for (int v = 0; v <= maxValue; ++v) counts[v] += other.counts[v];
+        total += other.total;
+        sum += other.sum;
+    }
+
+    double mean() const {
+        return total ? static_cast<double>(sum) / total : 0.0;
+    }
+
+    int percentile(double q) const {
+        unsigned long long rank = static_cast<unsigned long long>(q * total);
+        unsigned long long seen = 0;
+        for (int v = 0; v <= maxValue; ++v) {
+            seen += counts[v];
+            if (seen > rank) return v;
+        }
+        return maxValue;
+    }
+};
+
+struct MatchupStats {
+    unsigned long long battles = 0;
+    unsigned long long wins = 0;
+    Histogram<100> turnsToKill; // player turns, winning battles only
+    Histogram<255> damage;      // health removed from the enemy per attack or special
+    Histogram<255> damageTaken; // player health lost per battle
+
+    void merge(const MatchupStats& other) {
+        battles += other.battles;
+        wins += other.wins;
+        turnsToKill.merge(other.turnsToKill);
+        damage.merge(other.damage);
+        damageTaken.merge(other.damageTaken);
+    }
+};
+
+// One silent 1v1 battle driven by the policy, in strict alternation: the
+// player acts, then the enemy if it survived. This is the model --simulate
+// and --balance measure; it ignores speed, unlike battle()'s initiative order.
+void simulateBattle(Player& player, Enemy& enemy, const BattlePolicy& policy, MatchupStats& stats) {
+    int turns = 0;
+    int healthLost = 0;
+    while (player.isAlive() && enemy.isAlive()) {
+        ++turns;
+        int enemyBefore = enemy.getHealth();
+        switch (chooseAction(policy, player)) {
+            case BattleAction::Attack:
                 player.attack(enemy);
+                stats.damage.add(enemyBefore - enemy.getHealth());
                 break;
-            case 2: {
-                int heal = rand() % 10 + 5;
-                player.takeDamage(-heal); // heal
-                if (player.getHealth() > player.getMaxHealth())
-                    player.takeDamage(player.getHealth() - player.getMaxHealth());
-                std::cout << player.getName() << " defends and heals " << heal << " HP!\n";
+            case BattleAction::Special:
+                player.specialAbility(enemy);
+                stats.damage.add(enemyBefore - enemy.getHealth());
                 break;
-            }
-            case 3:
+            case BattleAction::Potion:
                 player.usePotion();
                 break;
-            case 4:
-                player.specialAbility(enemy);
-                break;
-            case 5:
-                player.showInventory();
-                continue; // skip enemy attack after showing inventory
-            case 6:
-                player.equipItem();
-                continue;
-            case 7:
-                player.unequipItem();
-                continue;
-            default:
-                std::cout << "Invalid choice.\n";
-                continue;
         }
-
         if (enemy.isAlive()) {
+            int before = player.getHealth();
             enemy.attack(player);
+            healthLost += before - player.getHealth();
         }
+    }
+    ++stats.battles;
+    stats.damageTaken.add(healthLost);
+    if (player.isAlive()) {
+        ++stats.wins;
+        stats.turnsToKill.add(turns);
+    }
+}
 
-        std::cout << "\nStatus:\n";
-        player.showStats();
-        enemy.showStats();
+#ifdef RPG_X86
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+// Structure-of-arrays table of independent battles that all share one
+// player class, enemy kind and policy. step() plays one turn of every
+// unfinished battle in one pass over the columns with no virtual calls;
+// the AVX2 kernel runs four battles per iteration with every decision
+// turned into a mask. Each lane carries its own xoshiro256** state and draws in
+// the same order as simulateBattle, so lanes seeded alike give identical
+// results.
+class BattleBatch {
+    PlayerClass playerClass;
+    BattlePolicy policy;
+    int specialCost;
+    int potionCount; // potions carried at the start, all healing potionHeal
+    int potionHeal;
+
+    // One entry per battle.
+    std::vector<int32_t> health, maxHealth, attackPower, weaponBonus, armor;
+    std::vector<int32_t> enemyHealth, enemyAttack;
+    std::vector<int32_t> potionsUsed, turns, healthLost;
+    std::vector<int32_t> dealt; // damage of this turn's hit, -1 when there was none
+    std::vector<uint64_t> s0, s1, s2, s3;
+
+    template <typename F>
+    void forEachColumn(F f) {
+        for (auto* column : { &health, &maxHealth, &attackPower, &weaponBonus, &armor, &enemyHealth,
+                              &enemyAttack, &potionsUsed, &turns, &healthLost, &dealt }) {
+            f(*column);
+        }
+        for (auto* column : { &s0, &s1, &s2, &s3 }) f(*column);
     }
 
-    if (player.isAlive()) {
-        std::cout << "\nYou defeated " << enemy.getName() << "!\n";
-        player.gainExperience(enemy.getExperienceReward());
-    } else {
-        std::cout << "\nYou were defeated by " << enemy.getName() << "...\n";
+    // Rng::next followed by Rng::below(range) on one lane's state.
+    static int32_t roll(uint64_t& x0, uint64_t& x1, uint64_t& x2, uint64_t& x3, int32_t range) {
+        uint64_t result = ((x1 * 5) << 7 | (x1 * 5) >> 57) * 9;
+        uint64_t t = x1 << 17;
+        x2 ^= x0;
+        x3 ^= x1;
+        x1 ^= x2;
+        x0 ^= x3;
+        x2 ^= t;
+        x3 = (x3 << 45) | (x3 >> 19);
+        return static_cast<int32_t>(((result >> 32) * static_cast<uint32_t>(range)) >> 32);
     }
+
+    // One turn of lane i, the same rules as chooseAction and simulateBattle.
+    // Returns 1 if the battle was still running.
+    template <PlayerClass cls>
+    size_t playLane(size_t i) {
+        int32_t hp = health[i];
+        int32_t enemy = enemyHealth[i];
+        dealt[i] = -1;
+        if (hp <= 0 || enemy <= 0) return 0;
+        ++turns[i];
+        uint64_t x0 = s0[i], x1 = s1[i], x2 = s2[i], x3 = s3[i];
+
+        if (potionsUsed[i] < potionCount && hp * 100 < maxHealth[i] * policy.potionBelowPercent) {
+            hp = std::min(maxHealth[i], hp + potionHeal);
+            ++potionsUsed[i];
+        } else {
+            const int32_t weapon = weaponBonus[i];
+            int32_t before = enemy;
+            if (policy.useSpecial && hp > specialCost) {
+                if (cls == PlayerClass::Warrior) {
+                    enemy -= roll(x0, x1, x2, x3, attackPower[i] + 10) + weapon + 10;
+                    hp = std::max(0, hp - specialCost);
+                } else if (cls == PlayerClass::Mage) {
+                    enemy -= roll(x0, x1, x2, x3, attackPower[i] + 15) + weapon + 5;
+                } else {
+                    for (int shot = 0; shot < 3 && enemy > 0; ++shot) {
+                        enemy = std::max(0, enemy - (roll(x0, x1, x2, x3, attackPower[i]) + weapon / 2 + 3));
+                    }
+                }
+            } else {
+                enemy -= roll(x0, x1, x2, x3, attackPower[i]) + 1 + weapon;
+            }
+            enemy = std::max(0, enemy);
+            dealt[i] = before - enemy;
+        }
+
+        if (enemy > 0) {
+            int32_t taken = std::min(hp, std::max(0, roll(x0, x1, x2, x3, enemyAttack[i]) + 1 - armor[i]));
+            hp -= taken;
+            healthLost[i] += taken;
+        }
+        health[i] = hp;
+        enemyHealth[i] = enemy;
+        s0[i] = x0;
+        s1[i] = x1;
+        s2[i] = x2;
+        s3[i] = x3;
+        return 1;
+    }
+
+#ifdef RPG_X86
+    // roll() for four lanes at once; lanes whose take mask is clear keep
+    // their state. AVX2 has no 64-bit multiply, but the constant factors
+    // are shifts and adds, and the range multiply only needs 32 x 32 bits.
+    __attribute__((target("avx2"))) static __m128i avx2Roll(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3,
+                                                             __m128i take, __m128i range) {
+        __m256i times5 = _mm256_add_epi64(_mm256_slli_epi64(x1, 2), x1);
+        __m256i rotated = _mm256_or_si256(_mm256_slli_epi64(times5, 7), _mm256_srli_epi64(times5, 57));
+        __m256i result = _mm256_add_epi64(_mm256_slli_epi64(rotated, 3), rotated);
+        __m256i t = _mm256_slli_epi64(x1, 17);
+        __m256i n2 = _mm256_xor_si256(x2, x0);
+        __m256i n3 = _mm256_xor_si256(x3, x1);
+        __m256i n1 = _mm256_xor_si256(x1, n2);
+        __m256i n0 = _mm256_xor_si256(x0, n3);
+        n2 = _mm256_xor_si256(n2, t);
+        n3 = _mm256_or_si256(_mm256_slli_epi64(n3, 45), _mm256_srli_epi64(n3, 19));
+        __m256i mask = _mm256_cvtepi32_epi64(take);
+        x0 = _mm256_blendv_epi8(x0, n0, mask);
+        x1 = _mm256_blendv_epi8(x1, n1, mask);
+        x2 = _mm256_blendv_epi8(x2, n2, mask);
+        x3 = _mm256_blendv_epi8(x3, n3, mask);
+        __m256i product = _mm256_mul_epu32(_mm256_srli_epi64(result, 32), _mm256_cvtepu32_epi64(range));
+        __m256i high = _mm256_srli_epi64(product, 32);
+        return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(high, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+    }
+
+    __attribute__((target("avx2"))) static __m128i load(const std::vector<int32_t>& column, size_t i) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(column.data() + i));
+    }
+
+    __attribute__((target("avx2"))) static void store(std::vector<int32_t>& column, size_t i, __m128i value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(column.data() + i), value);
+    }
+
+    __attribute__((target("avx2"))) static __m256i load64(const std::vector<uint64_t>& column, size_t i) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column.data() + i));
+    }
+
+    __attribute__((target("avx2"))) static void store64(std::vector<uint64_t>& column, size_t i, __m256i value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(column.data() + i), value);
+    }
+
+    __attribute__((target("avx2"))) static __m128i select(__m128i mask, __m128i ifSet, __m128i ifClear) {
+        return _mm_blendv_epi8(ifClear, ifSet, mask);
+    }
+
+    // value / 2 rounded toward zero, as in C++.
+    __attribute__((target("avx2"))) static __m128i half(__m128i value) {
+        return _mm_srai_epi32(_mm_add_epi32(value, _mm_srli_epi32(value, 31)), 1);
+    }
+
+    // playLane for four lanes at a time, with every decision turned into
+    // a mask. Handles lanes [0, n - n % 4) and returns how many of them
+    // were still running.
+    template <PlayerClass cls>
+    __attribute__((target("avx2"))) size_t avx2PlayTurn(size_t n) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i potions = _mm_set1_epi32(potionCount);
+        const __m128i heal = _mm_set1_epi32(potionHeal);
+        const __m128i potionPercent = _mm_set1_epi32(policy.potionBelowPercent);
+        const __m128i hundred = _mm_set1_epi32(100);
+        const __m128i cost = _mm_set1_epi32(specialCost);
+        const __m128i useSpecial = _mm_set1_epi32(policy.useSpecial ? -1 : 0);
+        const __m128i specialRange = _mm_set1_epi32(cls == PlayerClass::Warrior ? 10 : cls == PlayerClass::Mage ? 15 : 0);
+        const __m128i specialBonus = _mm_set1_epi32(cls == PlayerClass::Warrior ? 10 : cls == PlayerClass::Mage ? 5 : 3);
+        const __m128i three = _mm_set1_epi32(3);
+        __m128i active = zero;
+        for (size_t i = 0; i + 4 <= n; i += 4) {
+            __m256i x0 = load64(s0, i), x1 = load64(s1, i), x2 = load64(s2, i), x3 = load64(s3, i);
+            __m128i hp = load(health, i);
+            __m128i enemy = load(enemyHealth, i);
+            __m128i maxHp = load(maxHealth, i);
+            __m128i atk = load(attackPower, i);
+            __m128i weapon = load(weaponBonus, i);
+            __m128i used = load(potionsUsed, i);
+
+            __m128i alive = _mm_and_si128(_mm_cmpgt_epi32(hp, zero), _mm_cmpgt_epi32(enemy, zero));
+            store(turns, i, _mm_sub_epi32(load(turns, i), alive));
+            active = _mm_sub_epi32(active, alive);
+
+            __m128i potion = _mm_and_si128(alive, _mm_cmpgt_epi32(potions, used));
+            potion = _mm_and_si128(potion, _mm_cmpgt_epi32(_mm_mullo_epi32(maxHp, potionPercent),
+                                                           _mm_mullo_epi32(hp, hundred)));
+            __m128i hits = _mm_andnot_si128(potion, alive);
+            __m128i special = _mm_and_si128(_mm_and_si128(hits, useSpecial), _mm_cmpgt_epi32(hp, cost));
+            hp = select(potion, _mm_min_epi32(maxHp, _mm_add_epi32(hp, heal)), hp);
+            store(potionsUsed, i, _mm_sub_epi32(used, potion));
+
+            __m128i specialHit = _mm_add_epi32(cls == PlayerClass::Archer ? half(weapon) : weapon, specialBonus);
+            __m128i bonus = select(special, specialHit, _mm_add_epi32(weapon, one));
+            __m128i range = _mm_add_epi32(atk, _mm_and_si128(special, specialRange));
+            __m128i damage = _mm_add_epi32(avx2Roll(x0, x1, x2, x3, hits, range), bonus);
+            __m128i before = enemy;
+            enemy = select(hits, _mm_max_epi32(zero, _mm_sub_epi32(enemy, damage)), enemy);
+            if (cls == PlayerClass::Archer) {
+                for (int shot = 1; shot < 3; ++shot) {
+                    __m128i fires = _mm_and_si128(special, _mm_cmpgt_epi32(enemy, zero));
+                    __m128i shotDamage = _mm_add_epi32(avx2Roll(x0, x1, x2, x3, fires, atk),
+                                                       _mm_add_epi32(half(weapon), three));
+                    enemy = select(fires, _mm_max_epi32(zero, _mm_sub_epi32(enemy, shotDamage)), enemy);
+                }
+            }
+            store(dealt, i, select(hits, _mm_sub_epi32(before, enemy), _mm_set1_epi32(-1)));
+            if (cls == PlayerClass::Warrior) {
+                hp = select(special, _mm_max_epi32(zero, _mm_sub_epi32(hp, cost)), hp);
+            }
+
+            __m128i strikes = _mm_and_si128(alive, _mm_cmpgt_epi32(enemy, zero));
+            __m128i strike = _mm_add_epi32(avx2Roll(x0, x1, x2, x3, strikes, load(enemyAttack, i)), one);
+            __m128i taken = _mm_min_epi32(hp, _mm_max_epi32(zero, _mm_sub_epi32(strike, load(armor, i))));
+            taken = _mm_and_si128(taken, strikes);
+            store(health, i, _mm_sub_epi32(hp, taken));
+            store(healthLost, i, _mm_add_epi32(load(healthLost, i), taken));
+            store(enemyHealth, i, enemy);
+            store64(s0, i, x0);
+            store64(s1, i, x1);
+            store64(s2, i, x2);
+            store64(s3, i, x3);
+        }
+        alignas(16) int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), active);
+        return static_cast<size_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+
+    // One turn of every lane: four at a time with AVX2 where the CPU has
+    // it, lane by lane otherwise and for the remainder.
+    template <PlayerClass cls>
+    size_t playTurn() {
+        const size_t n = size();
+        size_t active = 0;
+        size_t i = 0;
+#ifdef RPG_X86
+        if (hasAvx2()) {
+            active = avx2PlayTurn<cls>(n);
+            i = n - n % 4;
+        }
+#endif
+        for (; i < n; ++i) active += playLane<cls>(i);
+        return active;
+    }
+
+public:
+    BattleBatch(const Player& prototype, const BattlePolicy& policy)
+        : playerClass(prototype.getClass()),
+          policy(policy),
+          specialCost(prototype.getSpecialCost()),
+          potionCount(static_cast<int>(prototype.getPotionHeals().size())),
+          potionHeal(potionCount > 0 ? prototype.getPotionHeals()[0] : 0) {}
+
+    // Whether battles of this player can run in a batch: every lane drinks
+    // the same heal, so the potions must all heal alike. Starting
+    // inventories hold a single potion.
+    static bool supports(const Player& player) {
+        std::vector<int> heals = player.getPotionHeals();
+        return std::all_of(heals.begin(), heals.end(), [&](int heal) { return heal == heals[0]; });
+    }
+
+    size_t size() const {
+        return health.size();
+    }
+
+    // Adds count battles between copies of player (which must be of the
+    // batch's class) and enemy. Battle k rolls from an Rng seeded with
+    // seedOf(k).
+    template <typename SeedFn>
+    void add(const Player& player, const Enemy& enemy, size_t count, SeedFn seedOf) {
+        const size_t first = size();
+        forEachColumn([&](auto& column) { column.resize(first + count); });
+        std::fill(health.begin() + first, health.end(), player.getHealth());
+        std::fill(maxHealth.begin() + first, maxHealth.end(), player.getMaxHealth());
+        std::fill(attackPower.begin() + first, attackPower.end(), player.getAttackPower());
+        std::fill(weaponBonus.begin() + first, weaponBonus.end(), player.getWeaponBonus());
+        std::fill(armor.begin() + first, armor.end(), player.getArmorDefense());
+        std::fill(enemyHealth.begin() + first, enemyHealth.end(), enemy.getHealth());
+        std::fill(enemyAttack.begin() + first, enemyAttack.end(), enemy.getAttackPower());
+        std::fill(dealt.begin() + first, dealt.end(), -1);
+        for (size_t k = 0; k < count; ++k) {
+            Rng rng(seedOf(k));
+            s0[first + k] = rng.stateWord(0);
+            s1[first + k] = rng.stateWord(1);
+            s2[first + k] = rng.stateWord(2);
+            s3[first + k] = rng.stateWord(3);
+        }
+    }
+
+    // Plays one turn of every unfinished battle and records the damage of
+    // each attack or special. Returns how many battles were still running.
+    size_t step(MatchupStats& stats) {
+        size_t active = 0;
+        switch (playerClass) {
+            case PlayerClass::Warrior: active = playTurn<PlayerClass::Warrior>(); break;
+            case PlayerClass::Mage: active = playTurn<PlayerClass::Mage>(); break;
+            case PlayerClass::Archer: active = playTurn<PlayerClass::Archer>(); break;
+        }
+        for (int32_t damage : dealt) {
+            if (damage >= 0) stats.damage.add(damage);
+        }
+        return active;
+    }
+
+    // Adds the outcome of every finished battle to stats and moves the
+    // unfinished ones to the front, keeping their order.
+    void retireFinished(MatchupStats& stats) {
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (health[i] > 0 && enemyHealth[i] > 0) {
+                forEachColumn([&](auto& column) { column[kept] = column[i]; });
+                ++kept;
+                continue;
+            }
+            ++stats.battles;
+            stats.damageTaken.add(healthLost[i]);
+            if (health[i] > 0) {
+                ++stats.wins;
+                stats.turnsToKill.add(turns[i]);
+            }
+        }
+        forEachColumn([&](auto& column) { column.resize(kept); });
+    }
+
+    // Plays every battle to the end and adds the outcomes to stats. Lanes
+    // are compacted once half of them have finished, so the long battles
+    // at the tail do not drag the whole table through every step.
+    void run(MatchupStats& stats) {
+        while (size_t active = step(stats)) {
+            if (active * 2 <= size()) retireFinished(stats);
+        }
+        retireFinished(stats);
+    }
+};
+
+// Fixed set of worker threads that run the indices of one job at a time.
+// The calling thread works through the job as well, so a pool of one is
+// just a loop.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t jobSize = 0;
+    std::atomic<size_t> nextIndex{0};
+    unsigned long long generation = 0;
+    size_t finished = 0; // workers done with the current generation
+    bool stopping = false;
+
+    void work() {
+        for (size_t i = nextIndex.fetch_add(1); i < jobSize; i = nextIndex.fetch_add(1)) {
+            (*job)(i);
+        }
+    }
+
+    void workerLoop() {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            lock.unlock();
+            work();
+            lock.lock();
+            if (++finished == workers.size()) done.notify_one();
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned threads) {
+        for (unsigned i = 1; i < threads; ++i) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    // Calls task(i) once for every i in [0, count) and returns when all
+    // calls have finished. The order across threads is unspecified.
+    void run(size_t count, const std::function<void(size_t)>& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &task;
+            jobSize = count;
+            nextIndex.store(0);
+            finished = 0;
+            ++generation;
+        }
+        wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return finished == workers.size(); });
+    }
+};
+
+// Battles per pool task, and lanes per BattleBatch: small enough that a
+// batch's columns stay in cache between turns. Each battle reseeds its own
+// Rng, so the batch size only affects speed, never the results.
+const int simulationBatch = 1024;
+
+// Runs battlesPerMatchup battles for every player, enemy and policy and
+// returns one MatchupStats per combination, player-major then enemy then
+// policy. Nothing is printed during the battles themselves. Battle b of
+// matchup m always draws from an Rng seeded by (mixed seed, m, b); the
+// seed is mixed first so that nearby seeds do not just permute the same
+// battle seeds among themselves. The
+// per-batch stats are merged in a fixed order, so a seed gives the same
+// results for any thread count, and two calls with the same seed roll the
+// same dice whatever the characters' stats. batched selects the
+// BattleBatch kernels; otherwise every battle runs through simulateBattle
+// on copies of the characters, with the same results.
+std::vector<MatchupStats> simulateMatchups(const std::vector<Player>& players, const std::vector<Enemy>& enemies,
+                                           const std::vector<BattlePolicy>& policies, int battlesPerMatchup,
+                                           uint64_t seed, ThreadPool& pool, bool batched) {
+    const int enemyCount = static_cast<int>(enemies.size());
+    const int policyCount = static_cast<int>(policies.size());
+    const int matchups = static_cast<int>(players.size()) * enemyCount * policyCount;
+    const int batchesPerMatchup = (battlesPerMatchup + simulationBatch - 1) / simulationBatch;
+    std::vector<MatchupStats> batchStats(static_cast<size_t>(matchups) * batchesPerMatchup);
+    const uint64_t base = Rng(seed).next();
+
+    auto runBatch = [&](size_t task) {
+        int matchup = static_cast<int>(task / batchesPerMatchup);
+        int firstBattle = static_cast<int>(task % batchesPerMatchup) * simulationBatch;
+        int lastBattle = std::min(battlesPerMatchup, firstBattle + simulationBatch);
+        const Player& prototype = players[matchup / (enemyCount * policyCount)];
+        const Enemy& enemyPrototype = enemies[matchup / policyCount % enemyCount];
+        const BattlePolicy& policy = policies[matchup % policyCount];
+
+        MatchupStats& stats = batchStats[task];
+        auto battleSeed = [&](int b) {
+            return base ^ (static_cast<uint64_t>(matchup) << 40) ^ static_cast<uint64_t>(b);
+        };
+        if (batched && BattleBatch::supports(prototype)) {
+            BattleBatch lanes(prototype, policy);
+            lanes.add(prototype, enemyPrototype, static_cast<size_t>(lastBattle - firstBattle),
+                      [&](size_t k) { return battleSeed(firstBattle + static_cast<int>(k)); });
+            lanes.run(stats);
+            return;
+        }
+        Rng rng;
+        for (int b = firstBattle; b < lastBattle; ++b) {
+            rng.reseed(battleSeed(b));
+            Player player = prototype;
+            Enemy enemy = enemyPrototype;
+            player.setRng(&rng);
+            enemy.setRng(&rng);
+            simulateBattle(player, enemy, policy, stats);
+        }
+    };
+    pool.run(batchStats.size(), runBatch);
+
+    std::vector<MatchupStats> results(static_cast<size_t>(matchups));
+    for (size_t task = 0; task < batchStats.size(); ++task) {
+        results[task / batchesPerMatchup].merge(batchStats[task]);
+    }
+    return results;
+}
+
+// Silent, equipped players of every class and enemies of every kind, built
+// from balance; battles start from copies of these.
+std::vector<Player> makeSimulationPlayers(const BalanceConfig& balance) {
+    std::vector<Player> players;
+    for (int c = 0; c < classCount; ++c) {
+        players.emplace_back("Sim", static_cast<PlayerClass>(c), balance);
+        players.back().setLog(nullptr);
+        players.back().equipStartingGear();
+    }
+    return players;
+}
+
+std::vector<Enemy> makeSimulationEnemies(const BalanceConfig& balance) {
+    std::vector<Enemy> enemies;
+    for (int kind = 0; kind < enemyKinds; ++kind) {
+        enemies.push_back(makeEnemy(kind, balance));
+        enemies.back().setLog(nullptr);
+    }
+    return enemies;
+}
+
+// Prints one table row per class, enemy and policy, as simulateMatchups
+// runs them.
+void runHeadlessSimulation(int battlesPerMatchup, int potionPercent, unsigned threads, uint64_t seed,
+                           bool batched) {
+    const std::vector<BattlePolicy> policies = {
+        { "attack", false, 0 },
+        { "special", true, 0 },
+        { "attack+potion<" + std::to_string(potionPercent) + "%", false, potionPercent },
+        { "special+potion<" + std::to_string(potionPercent) + "%", true, potionPercent },
+    };
+    const int policyCount = static_cast<int>(policies.size());
+    const std::vector<Player> players = makeSimulationPlayers(defaultBalance());
+    const std::vector<Enemy> enemies = makeSimulationEnemies(defaultBalance());
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(threads);
+    std::vector<MatchupStats> results =
+        simulateMatchups(players, enemies, policies, battlesPerMatchup, seed, pool, batched);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(9) << "Class" << std::setw(8) << "Enemy" << std::setw(20) << "Policy"
+              << std::right << std::setw(7) << "Win%" << "  " << std::setw(17) << "Turns mean/p50/p90"
+              << "  " << std::setw(20) << "Dmg/hit mean/p10/p90" << "  " << std::setw(19) << "HP lost mean/p90"
+              << "\n";
+
+    unsigned long long total = 0;
+    uint64_t digest = 0xcbf29ce484222325ULL; // FNV-1a over every count, for comparing runs
+    auto fold = [&digest](unsigned long long value) {
+        digest = (digest ^ value) * 0x100000001b3ULL;
+    };
+    for (size_t matchup = 0; matchup < results.size(); ++matchup) {
+        const Player& prototype = players[matchup / (enemyKinds * policyCount)];
+        const Enemy& enemyPrototype = enemies[matchup / policyCount % enemyKinds];
+        const BattlePolicy& policy = policies[matchup % policyCount];
+        const MatchupStats& stats = results[matchup];
+        total += stats.battles;
+        fold(stats.battles);
+        fold(stats.wins);
+        for (unsigned long long count : stats.turnsToKill.counts) fold(count);
+        for (unsigned long long count : stats.damage.counts) fold(count);
+        for (unsigned long long count : stats.damageTaken.counts) fold(count);
+
+        std::ostringstream turns, damage, lost;
+        turns << std::fixed << std::setprecision(1) << stats.turnsToKill.mean() << "/"
+              << stats.turnsToKill.percentile(0.5) << "/" << stats.turnsToKill.percentile(0.9);
+        damage << std::fixed << std::setprecision(1) << stats.damage.mean() << "/"
+               << stats.damage.percentile(0.1) << "/" << stats.damage.percentile(0.9);
+        lost << std::fixed << std::setprecision(1) << stats.damageTaken.mean() << "/"
+             << stats.damageTaken.percentile(0.9);
+        std::cout << std::left << std::setw(9) << prototype.getClassName() << std::setw(8)
+                  << enemyPrototype.getName() << std::setw(20) << policy.name << std::right
+                  << std::setw(6) << std::fixed << std::setprecision(1)
+                  << 100.0 * stats.wins / std::max(1ULL, stats.battles) << "%  " << std::setw(17)
+                  << turns.str() << "  " << std::setw(20) << damage.str() << "  " << std::setw(19)
+                  << lost.str() << "\n";
+    }
+    std::cout << total << " battles in " << std::setprecision(2) << seconds << " s on " << pool.size()
+              << " thread(s), seed " << seed << ", digest " << std::hex << std::setw(16) << std::setfill('0')
+              << digest << std::dec << std::setfill(' ') << "\n";
+}
+
+// ---- Large encounters ----
+
+// How a unit in an Encounter picks whom to hit among the standing units of
+// the other side.
+enum class Targeting : uint8_t { Front, Weakest, Strongest, Random };
+
+// Encounter tactics of each class and enemy kind.
+const Targeting classTargeting[classCount] = { Targeting::Front, Targeting::Weakest, Targeting::Strongest };
+const Targeting enemyTargeting[enemyKinds] = { Targeting::Random, Targeting::Front, Targeting::Strongest };
+
+struct UnitStats {
+    int health;
+    int attack; // hits roll 1..attack
+    int bonus;  // added to every hit
+    int armor;  // taken off every hit received
+    int speed;
+    Targeting targeting;
+};
+
+// An equipped hero of a class or an enemy of a kind, as an encounter unit.
+// Heroes only make plain attacks: no specials and no potions.
+UnitStats heroUnit(int cls, const BalanceConfig& balance) {
+    const BalanceConfig::ClassStats& stats = balance.classes[cls];
+    return { stats.health, stats.attack, stats.weaponPower, stats.armorPower, stats.speed, classTargeting[cls] };
+}
+
+UnitStats enemyUnit(int kind, const BalanceConfig& balance) {
+    const BalanceConfig::EnemyStats& stats = balance.enemies[kind];
+    return { stats.health, stats.attack, 0, 0, stats.speed, enemyTargeting[kind] };
+}
+
+// Silent battle between two sides of any size, with units stored as
+// columns and turns taken from an InitiativeQueue. All turns due at the
+// same tick pick targets and roll hits first, and the hits are then
+// applied as one batch of damage events, so units that fall during a tick
+// still land their blows. Picks skip units that the hits already rolled
+// this tick will kill, so a tick's attackers do not all pile onto one.
+//
+// Targets are found without scanning a side: Front keeps a cursor into the
+// side's units, Random picks from an unordered list of the standing ones,
+// and Weakest and Strongest use heaps of (health, unit) whose stale
+// entries are dropped when they reach the top.
+class Encounter {
+public:
+    struct Result {
+        int winner = -1; // side left standing; -1 for a draw or when the turn limit came first
+        unsigned long long turns = 0;
+        int64_t ticks = 0;
+        int standing[2] = { 0, 0 };
+        long long damage[2] = { 0, 0 }; // dealt by each side
+    };
+
+    void add(int side, const UnitStats& stats, int count) {
+        for (int i = 0; i < count; ++i) {
+            int32_t unit = static_cast<int32_t>(health.size());
+            sideOf.push_back(side);
+            health.push_back(stats.health);
+            attack.push_back(std::max(1, stats.attack));
+            bonus.push_back(stats.bonus);
+            armor.push_back(stats.armor);
+            speed.push_back(stats.speed);
+            targeting.push_back(stats.targeting);
+            incoming.push_back(0);
+            standingAt.push_back(static_cast<int32_t>(sides[side].standing.size()));
+            sides[side].units.push_back(unit);
+            sides[side].standing.push_back(unit);
+            sides[side].weakest.push_back({ stats.health, unit });
+            sides[side].strongest.push_back({ stats.health, unit });
+        }
+    }
+
+    // Fights until one side is down or turnLimit turns have been taken.
+    // Units keep their state afterwards, so an Encounter runs once.
+    Result run(Rng& rng, unsigned long long turnLimit) {
+        Result result;
+        InitiativeQueue order;
+        for (size_t unit = 0; unit < health.size(); ++unit) {
+            order.schedule(static_cast<int>(unit), speed[unit], 0);
+        }
+        for (Side& side : sides) {
+            std::make_heap(side.weakest.begin(), side.weakest.end(), std::greater<Entry>());
+            std::make_heap(side.strongest.begin(), side.strongest.end());
+        }
+
+        while (!sides[0].standing.empty() && !sides[1].standing.empty() && result.turns < turnLimit) {
+            const int64_t now = order.peek().time;
+            while (!order.empty() && order.peek().time == now) {
+                int32_t unit = order.pop().unit;
+                if (health[unit] <= 0) continue; // fallen units leave the order
+                int32_t target = pickTarget(unit, rng);
+                int32_t amount = rng.below(attack[unit]) + 1 + bonus[unit];
+                incoming[target] += std::max(0, amount - armor[target]);
+                events.push_back({ target, amount });
+                order.schedule(unit, speed[unit], now);
+                ++result.turns;
+            }
+            applyEvents(result);
+            result.ticks = now;
+        }
+
+        for (int side = 0; side < 2; ++side) {
+            result.standing[side] = static_cast<int>(sides[side].standing.size());
+        }
+        if (result.standing[0] == 0 && result.standing[1] > 0) result.winner = 1;
+        if (result.standing[1] == 0 && result.standing[0] > 0) result.winner = 0;
+        return result;
+    }
+
+private:
+    typedef std::pair<int32_t, int32_t> Entry; // (health, unit)
+
+    struct Side {
+        std::vector<int32_t> units; // in the order added
+        size_t front = 0;           // no unit before units[front] is standing
+        std::vector<int32_t> standing;
+        std::vector<Entry> weakest;   // min-heap
+        std::vector<Entry> strongest; // max-heap
+    };
+
+    struct DamageEvent {
+        int32_t target;
+        int32_t amount;
+    };
+
+    std::vector<int32_t> sideOf;
+    std::vector<int32_t> health;
+    std::vector<int32_t> attack;
+    std::vector<int32_t> bonus;
+    std::vector<int32_t> armor;
+    std::vector<int32_t> speed;
+    std::vector<Targeting> targeting;
+    std::vector<int32_t> incoming;   // damage rolled against the unit this tick
+    std::vector<int32_t> standingAt; // index in its side's standing list
+    Side sides[2];
+    std::vector<DamageEvent> events;
+
+    bool doomed(int32_t unit) const {
+        return incoming[unit] >= health[unit];
+    }
+
+    // Pops entries that are out of date or whose unit falls this tick;
+    // either way the entry would be stale by the next tick. -1 if none is
+    // left.
+    template <typename Compare>
+    int32_t topOf(std::vector<Entry>& heap, Compare compare) {
+        while (!heap.empty() && (health[heap.front().second] != heap.front().first || doomed(heap.front().second))) {
+            std::pop_heap(heap.begin(), heap.end(), compare);
+            heap.pop_back();
+        }
+        return heap.empty() ? -1 : heap.front().second;
+    }
+
+    // First unit of the side, in the order added, that is not doomed; -1
+    // if there is none.
+    int32_t frontOf(Side& side) {
+        while (side.front < side.units.size() && doomed(side.units[side.front])) ++side.front;
+        return side.front < side.units.size() ? side.units[side.front] : -1;
+    }
+
+    // Only called while the other side has a unit standing. When all of
+    // them are doomed already, any will do.
+    int32_t pickTarget(int32_t unit, Rng& rng) {
+        Side& foes = sides[sideOf[unit] ^ 1];
+        int32_t target = -1;
+        switch (targeting[unit]) {
+            case Targeting::Front:
+                target = frontOf(foes);
+                break;
+            case Targeting::Weakest:
+                target = topOf(foes.weakest, std::greater<Entry>());
+                break;
+            case Targeting::Strongest:
+                target = topOf(foes.strongest, std::less<Entry>());
+                break;
+            case Targeting::Random:
+                // A few redraws almost always find a unit that is not
+                // doomed; when they do not, most of the side is, and the
+                // front cursor finds one left over.
+                for (int draw = 0; draw < 4 && target < 0; ++draw) {
+                    int32_t pick = foes.standing[rng.below(static_cast<int>(foes.standing.size()))];
+                    if (!doomed(pick)) target = pick;
+                }
+                if (target < 0) target = frontOf(foes);
+                break;
+        }
+        return target >= 0 ? target : foes.standing.front();
+    }
+
+    void applyEvents(Result& result) {
+        for (const DamageEvent& event : events) {
+            int32_t target = event.target;
+            incoming[target] = 0;
+            if (health[target] <= 0) continue; // already fell this tick
+            int32_t dealt = std::min(health[target], std::max(0, event.amount - armor[target]));
+            if (dealt == 0) continue;
+            Side& side = sides[sideOf[target]];
+            result.damage[sideOf[target] ^ 1] += dealt;
+            health[target] -= dealt;
+            if (health[target] > 0) {
+                side.weakest.push_back({ health[target], target });
+                std::push_heap(side.weakest.begin(), side.weakest.end(), std::greater<Entry>());
+                side.strongest.push_back({ health[target], target });
+                std::push_heap(side.strongest.begin(), side.strongest.end());
+            } else {
+                int32_t moved = side.standing.back();
+                side.standing[standingAt[target]] = moved;
+                standingAt[moved] = standingAt[target];
+                side.standing.pop_back();
+            }
+        }
+        events.clear();
+
+        // Stale heap entries pile up with every hit; rebuild once they
+        // outnumber the live ones.
+        for (Side& side : sides) {
+            if (side.weakest.size() <= 2 * side.standing.size() + 64) continue;
+            side.weakest.clear();
+            for (int32_t unit : side.standing) side.weakest.push_back({ health[unit], unit });
+            side.strongest = side.weakest;
+            std::make_heap(side.weakest.begin(), side.weakest.end(), std::greater<Entry>());
+            std::make_heap(side.strongest.begin(), side.strongest.end());
+        }
+    }
+};
+
+// Runs many encounters of heroes against enemies, spread evenly over the
+// classes and enemy kinds, and prints who won and how fast the turns went.
+// Encounter e draws from an Rng seeded by (mixed seed, e), so a seed gives
+// the same results for any thread count.
+void runEncounters(int heroes, int enemies, int encounters, unsigned threads, uint64_t seed) {
+    const BalanceConfig& balance = defaultBalance();
+    const uint64_t base = Rng(seed).next();
+    const unsigned long long turnLimit = 1000ULL * (heroes + enemies);
+    std::vector<Encounter::Result> results(static_cast<size_t>(encounters));
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(threads);
+    pool.run(results.size(), [&](size_t e) {
+        Encounter encounter;
+        for (int c = 0; c < classCount; ++c) {
+            encounter.add(0, heroUnit(c, balance), heroes / classCount + (c < heroes % classCount));
+        }
+        for (int kind = 0; kind < enemyKinds; ++kind) {
+            encounter.add(1, enemyUnit(kind, balance), enemies / enemyKinds + (kind < enemies % enemyKinds));
+        }
+        Rng rng(base ^ e);
+        results[e] = encounter.run(rng, turnLimit);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long long wins[2] = { 0, 0 }, turns = 0;
+    double ticks = 0, standing[2] = { 0, 0 }, damage[2] = { 0, 0 };
+    uint64_t digest = 0xcbf29ce484222325ULL; // FNV-1a over every result, for comparing runs
+    auto fold = [&digest](unsigned long long value) {
+        digest = (digest ^ value) * 0x100000001b3ULL;
+    };
+    for (const Encounter::Result& result : results) {
+        if (result.winner >= 0) ++wins[result.winner];
+        turns += result.turns;
+        ticks += static_cast<double>(result.ticks);
+        fold(static_cast<unsigned long long>(result.winner + 1));
+        fold(result.turns);
+        for (int side = 0; side < 2; ++side) {
+            standing[side] += result.standing[side];
+            damage[side] += static_cast<double>(result.damage[side]);
+            fold(static_cast<unsigned long long>(result.standing[side]));
+            fold(static_cast<unsigned long long>(result.damage[side]));
+        }
+    }
+    const double n = std::max(1, encounters);
+    std::cout << std::fixed << std::setprecision(1) << heroes << " heroes against " << enemies << " enemies, "
+              << encounters << " encounter(s)\n"
+              << "Heroes win " << 100.0 * wins[0] / n << "%, enemies " << 100.0 * wins[1] / n << "%, undecided "
+              << 100.0 * (encounters - wins[0] - wins[1]) / n << "%\n"
+              << "Mean per encounter: " << turns / n << " turns over " << ticks / n / (initiativeScale / 10)
+              << " rounds at speed 10; heroes deal " << damage[0] / n << " damage and keep " << standing[0] / n
+              << " standing, enemies deal " << damage[1] / n << " and keep " << standing[1] / n << "\n";
+    std::cout << turns << " turns in " << std::setprecision(2) << seconds << " s on " << pool.size()
+              << " thread(s) (" << std::setprecision(1) << turns / std::max(seconds, 1e-9) / 1e6
+              << "M turns/s), seed " << seed << ", digest " << std::hex << std::setw(16) << std::setfill('0')
+              << digest << std::dec << std::setfill(' ') << "\n";
+}
+
+// ---- Balance search ----
+
+// One tunable number in a BalanceConfig. The search keeps it within
+// [minimum, maximum].
+struct BalanceKnob {
+    std::string name;
+    int* value;
+    int minimum;
+    int maximum = std::numeric_limits<int>::max();
+};
+
+std::vector<BalanceKnob> balanceKnobs(BalanceConfig& balance) {
+    const char* classNames[classCount] = { "Warrior", "Mage", "Archer" };
+    std::vector<BalanceKnob> knobs;
+    for (int c = 0; c < classCount; ++c) {
+        BalanceConfig::ClassStats& stats = balance.classes[c];
+        std::string name = classNames[c];
+        knobs.push_back({ name + " health", &stats.health, 1 });
+        knobs.push_back({ name + " attack", &stats.attack, 1 });
+        knobs.push_back({ name + " potion", &stats.potionHeal, 0 });
+        knobs.push_back({ name + " weapon", &stats.weaponPower, 0 });
+        knobs.push_back({ name + " armor", &stats.armorPower, 0 });
+    }
+    for (int kind = 0; kind < enemyKinds; ++kind) {
+        BalanceConfig::EnemyStats& stats = balance.enemies[kind];
+        std::string name = enemyNames[kind];
+        knobs.push_back({ name + " health", &stats.health, 1 });
+        knobs.push_back({ name + " attack", &stats.attack, 1 });
+    }
+    return knobs;
 }
 
-PlayerClass chooseClass() {
+// Battles of every class against every enemy under one policy. Results
+// are class-major, as simulateMatchups returns them.
+std::vector<MatchupStats> simulateBalance(const BalanceConfig& balance, const BattlePolicy& policy, int battles,
+                                          uint64_t seed, ThreadPool& pool) {
+    return simulateMatchups(makeSimulationPlayers(balance), makeSimulationEnemies(balance), { policy }, battles,
+                            seed, pool, true);
+}
+
+double winRate(const MatchupStats& stats) {
+    return static_cast<double>(stats.wins) / std::max(1ULL, stats.battles);
+}
+
+// Searches class stats, item powers and enemy stats for win rates close
+// to targets (one per class and enemy, class-major, as fractions) with the
+// scripted special+potion player. Coordinate descent over the integer
+// knobs: each sweep tries a step up and down on every knob and keeps
+// whatever lowers the loss, and the steps halve when a sweep finds
+// nothing. Every candidate is simulated with the same seed, so candidates
+// are compared on identical dice and the loss is a deterministic function
+// of the config; a fresh seed checks the result afterwards. The loss is
+// the squared win-rate error plus a charge for each relative change from
+// the defaults, and no knob may move more than maxChange of its default
+// either way, so the result stays a variation on the hand-tuned game
+// rather than a different one. XP rewards do not affect a single battle;
+// they are set last, in proportion to how many turns each tuned enemy
+// takes to kill, and never below the XP of a weaker kind.
+void runBalanceSearch(int battles, const std::vector<double>& targets, unsigned threads, uint64_t seed) {
+    const BattlePolicy policy = { "special+potion<40%", true, 40 };
+    const double changeWeight = 0.1;
+    const double maxChange = 0.5;
+    const double plateauWeight = 0.5;
+    const int maxSweeps = 60;
+
+    ThreadPool pool(threads);
+    const BalanceConfig original = defaultBalance();
+    BalanceConfig balance = original;
+    BalanceConfig reference = original;
+    std::vector<BalanceKnob> knobs = balanceKnobs(balance);
+    std::vector<BalanceKnob> defaults = balanceKnobs(reference);
+    for (size_t k = 0; k < knobs.size(); ++k) {
+        int value = *defaults[k].value;
+        knobs[k].minimum = std::max(knobs[k].minimum, static_cast<int>(std::ceil(value * (1.0 - maxChange))));
+        knobs[k].maximum = static_cast<int>(value * (1.0 + maxChange));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int evaluations = 0;
+    // A matchup won or lost every time gives no signal as stats change, so
+    // there the error also counts how one-sided the battles were: the
+    // share of health the player kept, or the enemy kept.
+    auto loss = [&](const std::vector<MatchupStats>& results) {
+        double total = 0.0;
+        for (size_t m = 0; m < results.size(); ++m) {
+            const MatchupStats& stats = results[m];
+            double rate = winRate(stats);
+            double error = rate - targets[m];
+            if (rate == 1.0 && targets[m] < 1.0) {
+                int health = balance.classes[m / enemyKinds].health;
+                error += plateauWeight * (1.0 - stats.damageTaken.mean() / std::max(1, health));
+            } else if (rate == 0.0 && targets[m] > 0.0) {
+                int health = balance.enemies[m % enemyKinds].health;
+                double dealt = static_cast<double>(stats.damage.sum) / std::max(1ULL, stats.battles);
+                error -= plateauWeight * std::max(0.0, 1.0 - dealt / std::max(1, health));
+            }
+            total += error * error;
+        }
+        for (size_t k = 0; k < knobs.size(); ++k) {
+            double change = static_cast<double>(*knobs[k].value - *defaults[k].value) /
+                            std::max(1, *defaults[k].value);
+            total += changeWeight * change * change;
+        }
+        return total;
+    };
+    auto evaluate = [&]() {
+        ++evaluations;
+        return loss(simulateBalance(balance, policy, battles, seed, pool));
+    };
+
+    const std::vector<MatchupStats> before = simulateBalance(balance, policy, battles, seed, pool);
+    double best = loss(before);
+    std::vector<int> steps;
+    for (const BalanceKnob& knob : knobs) steps.push_back(std::max(1, *knob.value / 4));
+
+    std::cout << "Tuning " << knobs.size() << " values against " << targets.size() << " win rates, "
+              << battles << " battles per matchup, " << pool.size() << " thread(s), seed " << seed << "\n";
+    for (int sweep = 1; sweep <= maxSweeps; ++sweep) {
+        bool improved = false;
+        for (size_t k = 0; k < knobs.size(); ++k) {
+            int& value = *knobs[k].value;
+            for (int direction : { +1, -1 }) {
+                bool moved = false;
+                // Keep walking while the same direction keeps helping.
+                while (value + direction * steps[k] >= knobs[k].minimum &&
+                       value + direction * steps[k] <= knobs[k].maximum) {
+                    int previous = value;
+                    value += direction * steps[k];
+                    double candidate = evaluate();
+                    if (candidate >= best) {
+                        value = previous;
+                        break;
+                    }
+                    best = candidate;
+                    moved = improved = true;
+                }
+                if (moved) break;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "sweep " << std::setw(2) << sweep << "  loss " << std::scientific << std::setprecision(3)
+                  << best << std::fixed << "  " << evaluations << " evaluations, " << std::setprecision(1)
+                  << seconds << " s\n";
+        if (!improved) {
+            bool halved = false;
+            for (int& step : steps) {
+                if (step > 1) {
+                    step /= 2;
+                    halved = true;
+                }
+            }
+            if (!halved) break;
+        }
+    }
+
+    const std::vector<MatchupStats> tuned = simulateBalance(balance, policy, battles, seed, pool);
+    const std::vector<MatchupStats> fresh = simulateBalance(balance, policy, battles, seed + 1, pool);
+
+    // XP per turn of fighting stays what the Goblin pays by default.
+    double turns[enemyKinds] = {};
+    for (int kind = 0; kind < enemyKinds; ++kind) {
+        for (int c = 0; c < classCount; ++c) turns[kind] += tuned[c * enemyKinds + kind].turnsToKill.mean();
+    }
+    for (int kind = 0; kind < enemyKinds; ++kind) {
+        double perTurn = original.enemies[0].xpReward / std::max(1e-9, turns[0]);
+        int xp = std::max(1, static_cast<int>(perTurn * turns[kind] + 0.5));
+        if (kind > 0) xp = std::max(xp, balance.enemies[kind - 1].xpReward);
+        balance.enemies[kind].xpReward = xp;
+    }
+
+    std::cout << "\n" << std::left << std::setw(9) << "Class" << std::setw(8) << "Enemy" << std::right
+              << std::setw(8) << "Target" << std::setw(9) << "Before" << std::setw(8) << "Tuned" << std::setw(12)
+              << "Fresh seed" << "\n";
+    for (size_t m = 0; m < targets.size(); ++m) {
+        std::cout << std::left << std::setw(9) << makeSimulationPlayers(original)[m / enemyKinds].getClassName()
+                  << std::setw(8) << enemyNames[m % enemyKinds] << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(7) << 100.0 * targets[m] << "%" << std::setw(8) << 100.0 * winRate(before[m]) << "%"
+                  << std::setw(7) << 100.0 * winRate(tuned[m]) << "%" << std::setw(11) << 100.0 * winRate(fresh[m])
+                  << "%\n";
+    }
+
+    // How far the tuned config strayed from the hand-tuned one.
+    double sumChange = 0.0;
+    double maxMoved = 0.0;
+    size_t worst = 0;
+    for (size_t k = 0; k < knobs.size(); ++k) {
+        double change = std::abs(static_cast<double>(*knobs[k].value - *defaults[k].value)) /
+                        std::max(1, *defaults[k].value);
+        sumChange += change;
+        if (change > maxMoved) {
+            maxMoved = change;
+            worst = k;
+        }
+    }
+    std::cout << "\nDistance from the defaults: mean change " << std::setprecision(1)
+              << 100.0 * sumChange / knobs.size() << "% per value, largest " << 100.0 * maxMoved << "% ("
+              << knobs[worst].name << " " << *defaults[worst].value << " -> " << *knobs[worst].value
+              << "), limit " << 100.0 * maxChange << "%\n";
+
+    std::cout << "\nTuned BalanceConfig (health, attack, potion, weapon, armor, speed / health, attack, xp, speed):\n";
+    const char* classNames[classCount] = { "Warrior", "Mage", "Archer" };
+    for (int c = 0; c < classCount; ++c) {
+        const BalanceConfig::ClassStats& stats = balance.classes[c];
+        std::cout << "    { " << stats.health << ", " << stats.attack << ", " << stats.potionHeal << ", "
+                  << stats.weaponPower << ", " << stats.armorPower << ", " << stats.speed << " },  // " << classNames[c]
+                  << "\n";
+    }
+    for (int kind = 0; kind < enemyKinds; ++kind) {
+        const BalanceConfig::EnemyStats& stats = balance.enemies[kind];
+        std::cout << "    { " << stats.health << ", " << stats.attack << ", " << stats.xpReward << ", " << stats.speed
+                  << " },  // " << enemyNames[kind] << "\n";
+    }
+}
+
+PlayerClass chooseClass(GameInput& input) {
     while (true) {
         std::cout << "\nChoose your class:\n";
         std::cout << "1. Warrior\n2. Mage\n3. Archer\n";
         std::cout << "Enter choice: ";
-        int choice;
-        std::cin >> choice;
+        int choice = 0;
+        input.readInt(choice);
+        if (input.finished()) return PlayerClass::Warrior; // out of input; the session ends unplayed
         if (choice == 1) return PlayerClass::Warrior;
         if (choice == 2) return PlayerClass::Mage;
         if (choice == 3) return PlayerClass::Archer;
@@ -461,41 +2154,151 @@ PlayerClass chooseClass() {
     }
 }
 
-int main() {
-    srand(static_cast<unsigned int>(time(0)));
-
+// One interactive game, from the title screen to the final stats.
+void playSession(GameInput& input) {
     printTitle();
 
     std::cout << "Enter your character's name: ";
-    std::string playerName;
-    std::cin.ignore(); // clear newline before getline
-    std::getline(std::cin, playerName);
+    std::string playerName = input.readLine();
 
-    PlayerClass pclass = chooseClass();
+    PlayerClass pclass = chooseClass(input);
+    if (input.finished()) return;
 
     Player player(playerName, pclass);
 
     std::cout << "\nGreetings, " << playerName << " the " << player.getClassName() << "!\n";
 
     bool keepPlaying = true;
-    while (keepPlaying && player.isAlive()) {
-        Enemy enemy = generateRandomEnemy();
+    while (keepPlaying && player.isAlive() && !input.finished()) {
+        std::vector<Enemy> enemies = generateRandomEnemies();
 
-        battle(player, enemy);
+        battle(player, enemies, input);
 
-        if (!player.isAlive()) break;
+        if (!player.isAlive() || input.finished()) break;
 
         std::cout << "\nDo you want to fight another enemy? (y/n): ";
-        char cont;
-        std::cin >> cont;
+        char cont = input.readChar();
         if (cont != 'y' && cont != 'Y') {
             keepPlaying = false;
         }
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // clear newline
     }
 
     std::cout << "\nThanks for playing! Final stats:\n";
     player.showStats();
+}
+
+// Plays each replay back and checks it turn by turn. Output is suppressed
+// unless showOutput is set, so playback runs at full speed. Returns the
+// number of replays that could not be read or did not match.
+int runReplays(const std::vector<std::string>& paths, bool showOutput) {
+    auto start = std::chrono::steady_clock::now();
+    int failed = 0;
+    size_t checkpoints = 0;
+    for (const std::string& path : paths) {
+        Replay replay;
+        if (!replay.load(path)) {
+            std::cerr << "Error loading replay " << path << "!\n";
+            ++failed;
+            continue;
+        }
+        sharedRng().reseed(replay.seed);
+        GameInput input(replay);
+        if (!showOutput) std::cout.setstate(std::ios::badbit);
+        playSession(input);
+        std::cout.clear();
+
+        checkpoints += input.checkpointCount();
+        if (size_t at = input.divergence()) {
+            std::cout << path << ": diverged at checkpoint " << at << "\n";
+            ++failed;
+        } else if (showOutput || paths.size() == 1) {
+            std::cout << path << ": ok, " << input.checkpointCount() << " checkpoints\n";
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << paths.size() - failed << " of " << paths.size() << " replays match (" << checkpoints
+              << " checkpoints, " << std::fixed << std::setprecision(3) << seconds << " s)\n";
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    sharedRng().reseed(static_cast<uint64_t>(time(0)));
+
+    // main --simulate [battles per matchup] [potion threshold %] [threads] [seed]
+    // threads 0 (the default) uses every hardware thread. --simulate-scalar
+    // runs the same battles through the class hierarchy, for comparison.
+    if (argc > 1 && (std::string(argv[1]) == "--simulate" || std::string(argv[1]) == "--simulate-scalar")) {
+        int battles = argc > 2 ? std::atoi(argv[2]) : 100000;
+        int potionPercent = argc > 3 ? std::atoi(argv[3]) : 40;
+        int threads = argc > 4 ? std::atoi(argv[4]) : 0;
+        uint64_t seed = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 1;
+        if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        runHeadlessSimulation(std::max(1, battles), potionPercent, static_cast<unsigned>(threads), seed,
+                              std::string(argv[1]) == "--simulate");
+        return 0;
+    }
+
+    // main --balance [battles per matchup] [threads] [seed] [target win %...]
+    // Targets are one per enemy for every class, or one per class and enemy
+    // (class-major); the default asks for 95/80/50% against Goblin/Orc/Dragon.
+    if (argc > 1 && std::string(argv[1]) == "--balance") {
+        int battles = argc > 2 ? std::atoi(argv[2]) : 20000;
+        int threads = argc > 3 ? std::atoi(argv[3]) : 0;
+        uint64_t seed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+        std::vector<double> given;
+        for (int i = 5; i < argc; ++i) given.push_back(std::atof(argv[i]) / 100.0);
+        if (given.empty()) given = { 0.95, 0.80, 0.50 };
+        if (given.size() != static_cast<size_t>(enemyKinds) && given.size() != static_cast<size_t>(classCount * enemyKinds)) {
+            std::cerr << "Give " << enemyKinds << " or " << classCount * enemyKinds << " target win rates.\n";
+            return 1;
+        }
+        std::vector<double> targets;
+        for (int m = 0; m < classCount * enemyKinds; ++m) {
+            targets.push_back(given.size() == static_cast<size_t>(enemyKinds) ? given[m % enemyKinds] : given[m]);
+        }
+        if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        runBalanceSearch(std::max(1, battles), targets, static_cast<unsigned>(threads), seed);
+        return 0;
+    }
+
+    // main --encounter [heroes] [enemies] [encounters] [threads] [seed]
+    // fights whole armies against each other; threads 0 uses every hardware
+    // thread.
+    if (argc > 1 && std::string(argv[1]) == "--encounter") {
+        int heroes = argc > 2 ? std::atoi(argv[2]) : 1000;
+        int enemies = argc > 3 ? std::atoi(argv[3]) : 1000;
+        int encounters = argc > 4 ? std::atoi(argv[4]) : 20;
+        int threads = argc > 5 ? std::atoi(argv[5]) : 0;
+        uint64_t seed = argc > 6 ? std::strtoull(argv[6], nullptr, 10) : 1;
+        if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        runEncounters(std::max(1, heroes), std::max(1, enemies), std::max(1, encounters),
+                      static_cast<unsigned>(threads), seed);
+        return 0;
+    }
+
+    // main --replay file... checks recorded sessions and exits nonzero if
+    // any no longer plays out the same; --replay-show also prints the game.
+    if (argc > 1 && (std::string(argv[1]) == "--replay" || std::string(argv[1]) == "--replay-show")) {
+        std::vector<std::string> paths(argv + 2, argv + argc);
+        return runReplays(paths, std::string(argv[1]) == "--replay-show") ? 1 : 0;
+    }
+
+    // main --record file [seed] plays normally and saves the session.
+    if (argc > 2 && std::string(argv[1]) == "--record") {
+        Replay replay;
+        replay.seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : static_cast<uint64_t>(time(0));
+        sharedRng().reseed(replay.seed);
+        GameInput input(&replay);
+        playSession(input);
+        if (!replay.save(argv[2])) {
+            std::cerr << "Error saving replay!\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    GameInput input;
+    playSession(input);
 
     return 0;
 }
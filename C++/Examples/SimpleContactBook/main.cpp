@@ -2,8 +2,27 @@
 #include <vector>
 #include <fstream>
 #include <string>
-#include <sstream>
-#include <algorithm> // for std::transform
+#include <algorithm>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cerrno>
+#include <limits>
+#include <optional>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)) // sse2Find needs SSE2 as a baseline
+#include <immintrin.h>
+#define CONTACTBOOK_X86 1
+#endif
 
 struct Contact {
     std::string name;
@@ -11,38 +30,1755 @@ struct Contact {
     std::string email;
 };
 
-void loadContacts(const std::string& filename, std::vector<Contact>& contacts) {
-    std::ifstream file(filename);
-    if (!file) {
+inline unsigned char asciiLower(unsigned char c) {
+    return (static_cast<unsigned>(c - 'A') < 26u) ? c | 0x20 : c;
+}
+
+// Case folding used for search terms and the name index: ASCII letters plus
+// the Latin-1 capitals U+00C0..U+00DE (except U+00D7) encoded as UTF-8.
+// Other bytes are kept as they are.
+void foldInPlace(std::string& result) {
+    for (size_t i = 0; i < result.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(result[i]);
+        if (c < 0x80) {
+            result[i] = static_cast<char>(asciiLower(c));
+        } else if (c == 0xC3 && i + 1 < result.size()) {
+            unsigned char next = static_cast<unsigned char>(result[i + 1]);
+            if (next >= 0x80 && next <= 0x9E && next != 0x97) {
+                result[i + 1] = static_cast<char>(next + 0x20);
+                ++i;
+            }
+        }
+    }
+}
+
+std::string foldCase(std::string_view text) {
+    std::string result(text);
+    foldInPlace(result);
+    return result;
+}
+
+// Case-insensitive substring test against a needle already passed through
+// foldCase. ASCII needles are matched in place with a SIMD first/last byte
+// filter; needles with UTF-8 bytes fall back to folding the haystack.
+namespace caseless {
+
+inline bool matchesAt(const char* hay, std::string_view needle) {
+    for (size_t j = 0; j < needle.size(); ++j) {
+        if (asciiLower(static_cast<unsigned char>(hay[j])) != static_cast<unsigned char>(needle[j])) return false;
+    }
+    return true;
+}
+
+inline bool scalarFind(std::string_view hay, std::string_view needle, size_t from) {
+    for (size_t i = from; i + needle.size() <= hay.size(); ++i) {
+        if (matchesAt(hay.data() + i, needle)) return true;
+    }
+    return false;
+}
+
+#ifdef CONTACTBOOK_X86
+inline __m128i lower16(__m128i v) {
+    __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+    __m128i upper = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(25)), offset);
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+inline bool sse2Find(std::string_view hay, std::string_view needle) {
+    const size_t m = needle.size();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= hay.size(); i += 16) {
+        __m128i a = lower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hay.data() + i)));
+        __m128i b = lower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hay.data() + i + m - 1)));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (matchesAt(hay.data() + i + bit, needle)) return true;
+            mask &= mask - 1;
+        }
+    }
+    return scalarFind(hay, needle, i);
+}
+
+__attribute__((target("avx2"))) inline __m256i lower32(__m256i v) {
+    __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+    __m256i upper = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(25)), offset);
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) bool avx2Find(std::string_view hay, std::string_view needle) {
+    const size_t m = needle.size();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= hay.size(); i += 32) {
+        __m256i a = lower32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay.data() + i)));
+        __m256i b = lower32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay.data() + i + m - 1)));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (matchesAt(hay.data() + i + bit, needle)) return true;
+            mask &= mask - 1;
+        }
+    }
+    return sse2Find(hay.substr(i), needle);
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+inline bool isAscii(std::string_view text) {
+    for (char c : text) {
+        if (static_cast<unsigned char>(c) >= 0x80) return false;
+    }
+    return true;
+}
+
+} // namespace caseless
+
+bool containsFolded(std::string_view hay, std::string_view foldedNeedle) {
+    if (foldedNeedle.empty()) return true;
+    if (foldedNeedle.size() > hay.size()) return false;
+
+    if (!caseless::isAscii(foldedNeedle)) {
+        // UTF-8 needle: fold the haystack into a reused per-thread buffer.
+        thread_local std::string folded;
+        folded.assign(hay);
+        foldInPlace(folded);
+        return folded.find(foldedNeedle) != std::string::npos;
+    }
+#ifdef CONTACTBOOK_X86
+    if (caseless::hasAvx2() && hay.size() >= 32 + foldedNeedle.size()) return caseless::avx2Find(hay, foldedNeedle);
+    return caseless::sse2Find(hay, foldedNeedle);
+#else
+    return caseless::scalarFind(hay, foldedNeedle, 0);
+#endif
+}
+
+// Approximate substring matcher: for a folded pattern of up to 64 bytes, the
+// distance to a text is the smallest number of typos (byte insertions,
+// deletions, substitutions or swaps of adjacent bytes) that turn the pattern
+// into some substring of the text. This is Hyyrö's bit-parallel form of
+// Myers' algorithm extended with transpositions: a handful of word
+// operations per text byte. Text is folded on the fly as foldCase does.
+//
+// Each byte's update depends on the previous one, so one text at a time is
+// latency bound. With AVX2 and patterns up to 32 bytes, distances() runs
+// eight texts side by side in 32-bit lanes instead.
+class FuzzyPattern {
+public:
+    static constexpr size_t maxLength = 64;
+    static constexpr size_t lanes = 8;
+
+    explicit FuzzyPattern(std::string_view folded) : length(folded.size()) {
+        for (size_t i = 0; i < length; ++i) {
+            peq[static_cast<unsigned char>(folded[i])] |= uint64_t(1) << i;
+        }
+        for (int c = 'A'; c <= 'Z'; ++c) peq[c] = peq[c | 0x20];
+        for (int c = 0; c < 256; ++c) peq32[c] = static_cast<uint32_t>(peq[c]);
+        // Lanes are padded with NUL bytes, which must never match.
+        wide = length > 0 && length <= 32 && peq[0] == 0;
+    }
+
+    size_t size() const { return length; }
+
+    size_t distance(std::string_view text) const {
+        if (length == 0) return 0;
+        const uint64_t high = uint64_t(1) << (length - 1);
+        uint64_t vp = ~uint64_t(0);
+        uint64_t vn = 0;
+        uint64_t d0 = 0;
+        uint64_t pmPrev = 0;
+        size_t score = length;
+        size_t best = length;
+        unsigned char prev = 0;
+        for (char ch : text) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            // Latin-1 capitals after a 0xC3 lead byte, as in foldCase
+            if (prev == 0xC3 && c >= 0x80 && c <= 0x9E && c != 0x97) c += 0x20;
+            prev = c;
+            uint64_t pm = peq[c];
+            uint64_t swapped = ((~d0 & pm) << 1) & pmPrev;
+            d0 = swapped | (((pm & vp) + vp) ^ vp) | pm | vn;
+            uint64_t hp = vn | ~(d0 | vp);
+            uint64_t hn = d0 & vp;
+            score += (hp & high) ? 1 : 0;
+            score -= (hn & high) ? 1 : 0;
+            // A match may start anywhere, so no carry into the first row.
+            hp <<= 1;
+            hn <<= 1;
+            vp = hn | ~(d0 | hp);
+            vn = hp & d0;
+            pmPrev = pm;
+            best = std::min(best, score);
+        }
+        return best;
+    }
+
+    // Distances for lanes texts at once; unused lanes can be empty.
+    void distances(const std::string_view* texts, size_t* out) const {
+#ifdef CONTACTBOOK_X86
+        if (wide && caseless::hasAvx2()) {
+            avx2Distances(texts, out);
+            return;
+        }
+#endif
+        for (size_t l = 0; l < lanes; ++l) out[l] = distance(texts[l]);
+    }
+
+private:
+#ifdef CONTACTBOOK_X86
+    __attribute__((target("avx2"))) void avx2Distances(const std::string_view* texts, size_t* out) const {
+        // Copy the texts into zero-padded rows, then transpose them in 8x8
+        // byte blocks so each step loads one byte per lane.
+        size_t longest = 0;
+        for (size_t l = 0; l < lanes; ++l) longest = std::max(longest, texts[l].size());
+        const size_t stride = (longest + 7) & ~size_t(7);
+        uint8_t local[2 * lanes * 256];
+        std::vector<uint8_t> heap;
+        uint8_t* rows = local;
+        if (stride > 256) {
+            heap.resize(2 * lanes * stride);
+            rows = heap.data();
+        }
+        uint8_t* columns = rows + lanes * stride;
+        std::memset(rows, 0, lanes * stride);
+        for (size_t l = 0; l < lanes; ++l) {
+            // Unused lanes are empty views whose data() may be null.
+            if (!texts[l].empty()) std::memcpy(rows + l * stride, texts[l].data(), texts[l].size());
+        }
+
+        __m128i any = _mm_setzero_si128();
+        for (size_t block = 0; block < stride; block += 8) {
+            __m128i r[8];
+            for (size_t l = 0; l < lanes; ++l) {
+                r[l] = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows + l * stride + block));
+            }
+            __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+            __m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+            __m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+            __m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+            __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+            __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+            __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+            __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+            __m128i c[4] = { _mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2),
+                             _mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3) };
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(columns + block * lanes + 16 * k), c[k]);
+                any = _mm_or_si128(any, c[k]);
+            }
+        }
+
+        // Only texts with UTF-8 bytes need the Latin-1 folding step.
+        if (_mm_movemask_epi8(any)) {
+            avx2Kernel<true>(columns, longest, out);
+        } else {
+            avx2Kernel<false>(columns, longest, out);
+        }
+    }
+
+    template <bool Fold>
+    __attribute__((target("avx2"))) void avx2Kernel(const uint8_t* columns, size_t steps, size_t* out) const {
+        const __m256i ones = _mm256_set1_epi32(-1);
+        const __m256i high = _mm256_set1_epi32(static_cast<int>(uint32_t(1) << (length - 1)));
+        const __m256i lead = _mm256_set1_epi32(0xC3);
+        const __m256i below = _mm256_set1_epi32(0x7F);
+        const __m256i above = _mm256_set1_epi32(0x9F);
+        const __m256i times = _mm256_set1_epi32(0x97);
+        const __m256i caseBit = _mm256_set1_epi32(0x20);
+        __m256i vp = ones;
+        __m256i vn = _mm256_setzero_si256();
+        __m256i d0 = _mm256_setzero_si256();
+        __m256i pmPrev = _mm256_setzero_si256();
+        __m256i score = _mm256_set1_epi32(static_cast<int>(length));
+        __m256i best = score;
+        __m256i prev = _mm256_setzero_si256();
+        for (size_t i = 0; i < steps; ++i) {
+            __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(columns + i * lanes)));
+            if (Fold) {
+                __m256i fold = _mm256_and_si256(
+                    _mm256_and_si256(_mm256_cmpeq_epi32(prev, lead), _mm256_cmpgt_epi32(c, below)),
+                    _mm256_andnot_si256(_mm256_cmpeq_epi32(c, times), _mm256_cmpgt_epi32(above, c)));
+                c = _mm256_add_epi32(c, _mm256_and_si256(fold, caseBit));
+                prev = c;
+            }
+
+            __m256i pm = _mm256_i32gather_epi32(reinterpret_cast<const int*>(peq32), c, 4);
+            __m256i swapped = _mm256_and_si256(_mm256_slli_epi32(_mm256_andnot_si256(d0, pm), 1), pmPrev);
+            d0 = _mm256_or_si256(
+                _mm256_or_si256(swapped, _mm256_xor_si256(_mm256_add_epi32(_mm256_and_si256(pm, vp), vp), vp)),
+                _mm256_or_si256(pm, vn));
+            __m256i hp = _mm256_or_si256(vn, _mm256_andnot_si256(_mm256_or_si256(d0, vp), ones));
+            __m256i hn = _mm256_and_si256(d0, vp);
+            score = _mm256_sub_epi32(score, _mm256_cmpeq_epi32(_mm256_and_si256(hp, high), high));
+            score = _mm256_add_epi32(score, _mm256_cmpeq_epi32(_mm256_and_si256(hn, high), high));
+            hp = _mm256_slli_epi32(hp, 1);
+            hn = _mm256_slli_epi32(hn, 1);
+            vp = _mm256_or_si256(hn, _mm256_andnot_si256(_mm256_or_si256(d0, hp), ones));
+            vn = _mm256_and_si256(hp, d0);
+            pmPrev = pm;
+            best = _mm256_min_epu32(best, score);
+        }
+
+        alignas(32) uint32_t result[lanes];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(result), best);
+        for (size_t l = 0; l < lanes; ++l) out[l] = result[l];
+    }
+#endif
+
+    uint64_t peq[256] = {};
+    uint32_t peq32[256];
+    size_t length;
+    bool wide;
+};
+
+// Sorted document numbers stored as varint-encoded deltas. Every skipInterval
+// entries a (value, byte offset) skip point is kept so intersections can jump
+// ahead instead of decoding the whole list.
+class PostingList {
+public:
+    static constexpr uint32_t skipInterval = 64;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void add(uint32_t id) {
+        if (count == 0 || id > last) {
+            append(id);
+            return;
+        }
+        std::vector<uint32_t> ids = decode();
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) return;
+        ids.insert(it, id);
+        encode(ids);
+    }
+
+    std::vector<uint32_t> decode() const {
+        std::vector<uint32_t> ids;
+        ids.reserve(count);
+        Cursor cursor(*this);
+        for (; !cursor.done(); cursor.next()) ids.push_back(cursor.value());
+        return ids;
+    }
+
+    // Forward iterator over the list with skip-assisted seeking.
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& list) : list(list) { load(0, 0, 0); }
+
+        bool done() const { return index >= list.count; }
+        uint32_t value() const { return current; }
+
+        void next() {
+            if (++index < list.count) current += readVarint();
+        }
+
+        // Advances to the first id >= target.
+        void seek(uint32_t target) {
+            if (done() || current >= target) return;
+            const auto& skips = list.skips;
+            auto it = std::lower_bound(skips.begin(), skips.end(), target,
+                                       [](const Skip& s, uint32_t t) { return s.value < t; });
+            if (it != skips.begin()) {
+                size_t block = (it - skips.begin()) - 1;
+                size_t blockStart = (block + 1) * skipInterval;
+                if (blockStart > index) load(blockStart, skips[block].offset, skips[block].value);
+            }
+            while (!done() && current < target) next();
+        }
+
+    private:
+        void load(size_t at, size_t byteOffset, uint32_t base) {
+            index = at;
+            offset = byteOffset;
+            current = base;
+            if (index < list.count) current += readVarint();
+        }
+
+        uint32_t readVarint() {
+            uint32_t v = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t b = list.bytes[offset++];
+                v |= static_cast<uint32_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) return v;
+            }
+        }
+
+        const PostingList& list;
+        size_t index = 0;
+        size_t offset = 0;
+        uint32_t current = 0;
+    };
+
+private:
+    struct Skip {
+        uint32_t value;   // last id before the block
+        uint32_t offset;  // byte offset of the block's first delta
+    };
+
+    void append(uint32_t id) {
+        uint32_t base = count ? last : 0;
+        if (count > 0 && count % skipInterval == 0) {
+            skips.push_back({ last, static_cast<uint32_t>(bytes.size()) });
+        }
+        uint32_t delta = id - base;
+        while (delta >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(delta));
+        last = id;
+        ++count;
+    }
+
+    void encode(const std::vector<uint32_t>& ids) {
+        bytes.clear();
+        skips.clear();
+        count = 0;
+        last = 0;
+        for (uint32_t id : ids) append(id);
+    }
+
+    std::vector<uint8_t> bytes;
+    std::vector<Skip> skips;
+    uint32_t last = 0;
+    uint32_t count = 0;
+};
+
+// Inverted index from case-folded name trigrams to document numbers. Terms of
+// three or more characters only need to verify the contacts whose names
+// contain every trigram of the term. Entries are never removed: callers
+// number documents increasingly (so adds append) and skip stale numbers.
+class TrigramIndex {
+public:
+    void clear() { postings.clear(); }
+
+    void add(uint32_t doc, std::string_view name) {
+        folded.assign(name);
+        foldInPlace(folded);
+        trigramsOf(folded, grams);
+        for (uint32_t gram : grams) postings[gram].add(doc);
+    }
+
+    // Documents whose names contain all trigrams of a folded term of at
+    // least three characters. Callers still verify each candidate.
+    std::vector<uint32_t> candidates(const std::string& foldedTerm) const {
+        std::vector<const PostingList*> lists;
+        std::vector<uint32_t> grams;
+        trigramsOf(foldedTerm, grams);
+        for (uint32_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it == postings.end()) return {};
+            lists.push_back(&it->second);
+        }
+        std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b) {
+            return a->size() < b->size();
+        });
+
+        // Start from the rarest trigram and seek through the longer lists.
+        std::vector<uint32_t> result = lists.front()->decode();
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            PostingList::Cursor cursor(*lists[i]);
+            size_t kept = 0;
+            for (uint32_t id : result) {
+                cursor.seek(id);
+                if (cursor.done()) break;
+                if (cursor.value() == id) result[kept++] = id;
+            }
+            result.resize(kept);
+        }
+        return result;
+    }
+
+    // Sorted documents containing at least minShared of the term's distinct
+    // trigrams; docCount bounds the document numbers.
+    std::vector<uint32_t> candidatesSharing(const std::string& foldedTerm, size_t minShared, size_t docCount) const {
+        std::vector<uint32_t> grams;
+        trigramsOf(foldedTerm, grams);
+        std::vector<uint8_t> shared(docCount);
+        std::vector<uint32_t> result;
+        for (uint32_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it == postings.end()) continue;
+            for (PostingList::Cursor cursor(it->second); !cursor.done(); cursor.next()) {
+                if (++shared[cursor.value()] == minShared) result.push_back(cursor.value());
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    static void trigramsOf(const std::string& folded, std::vector<uint32_t>& grams) {
+        grams.clear();
+        for (size_t i = 0; i + 3 <= folded.size(); ++i) {
+            grams.push_back(static_cast<uint32_t>(static_cast<unsigned char>(folded[i])) << 16 |
+                            static_cast<uint32_t>(static_cast<unsigned char>(folded[i + 1])) << 8 |
+                            static_cast<uint32_t>(static_cast<unsigned char>(folded[i + 2])));
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    std::unordered_map<uint32_t, PostingList> postings;
+    std::string folded;           // scratch for add
+    std::vector<uint32_t> grams;  // scratch for add
+};
+
+// Sorted (folded name, document) array for autocomplete. New names go to a
+// small sorted delta that is merged into the main array once it grows past
+// about sqrt(N) entries; removed entries are tombstoned until that merge.
+// A lookup is two binary searches plus a merge walk over the first K hits.
+//
+// Folded names are kept back to back in one arena; entries hold an offset
+// plus the first eight bytes packed big-endian, which settles most
+// comparisons without touching the arena.
+class PrefixIndex {
+public:
+    // forEach(visit) must call visit(doc, name) for every contact.
+    template <typename ForEach>
+    void build(ForEach forEach) {
+        main.clear();
+        delta.clear();
+        keys.clear();
+        deadInMain = 0;
+        std::string folded;
+        forEach([&](uint32_t doc, std::string_view name) {
+            foldInto(name, folded);
+            main.push_back(store(folded, doc));
+        });
+        std::sort(main.begin(), main.end(), less());
+    }
+
+    void add(uint32_t id, std::string_view name) {
+        std::string folded;
+        foldInto(name, folded);
+        Entry entry = store(folded, id);
+        delta.insert(std::upper_bound(delta.begin(), delta.end(), entry, less()), entry);
+        if (delta.size() * delta.size() > std::max<size_t>(main.size(), 1 << 16)) merge();
+    }
+
+    void remove(uint32_t id, std::string_view name) {
+        std::string folded;
+        foldInto(name, folded);
+        Probe probe{ folded, id };
+        auto it = std::lower_bound(delta.begin(), delta.end(), probe, less());
+        if (it != delta.end() && same(*it, probe)) {
+            delta.erase(it);
+            return;
+        }
+        // A tombstone may share its key and index with the live entry.
+        for (it = std::lower_bound(main.begin(), main.end(), probe, less()); it != main.end() && same(*it, probe); ++it) {
+            if (!it->removed) {
+                it->removed = true;
+                ++deadInMain;
+                return;
+            }
+        }
+    }
+
+    // First k documents, by folded name, whose names start with the folded prefix.
+    std::vector<uint32_t> firstMatches(std::string_view foldedPrefix, size_t k) const {
+        std::vector<uint32_t> result;
+        Probe probe{ foldedPrefix, 0 };
+        auto a = std::lower_bound(main.begin(), main.end(), probe, less());
+        auto b = std::lower_bound(delta.begin(), delta.end(), probe, less());
+        auto matches = [&](const Entry& e) {
+            return key(e).compare(0, foldedPrefix.size(), foldedPrefix) == 0;
+        };
+        while (result.size() < k) {
+            bool haveA = (a != main.end() && matches(*a));
+            bool haveB = (b != delta.end() && matches(*b));
+            if (!haveA && !haveB) break;
+            if (haveA && (!haveB || less()(*a, *b))) {
+                if (!a->removed) result.push_back(a->id);
+                ++a;
+            } else {
+                result.push_back(b->id);
+                ++b;
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Entry {
+        uint64_t head;    // first eight key bytes, big-endian, zero padded
+        uint64_t offset;  // key bytes in the arena
+        uint32_t length;
+        uint32_t id;
+        bool removed;     // tombstone, kept in place so the array stays sorted
+    };
+
+    // A key that is not in the arena, for searching.
+    struct Probe {
+        std::string_view key;
+        uint32_t id;
+    };
+
+    static void foldInto(std::string_view name, std::string& out) {
+        out.assign(name);
+        foldInPlace(out);
+    }
+
+    static uint64_t headOf(std::string_view key) {
+        uint64_t head = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            head = (head << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+        }
+        return head;
+    }
+
+    Entry store(std::string_view folded, uint32_t id) {
+        Entry e{ headOf(folded), keys.size(), static_cast<uint32_t>(folded.size()), id, false };
+        keys.append(folded);
+        return e;
+    }
+
+    std::string_view key(const Entry& e) const { return { keys.data() + e.offset, e.length }; }
+    std::string_view key(const Probe& p) const { return p.key; }
+    static uint64_t head(const Entry& e) { return e.head; }
+    static uint64_t head(const Probe& p) { return headOf(p.key); }
+
+    // Orders by key, then id. Keys that differ in their first eight bytes
+    // are ordered by the heads alone; zero padding never changes the order
+    // because a shorter key sorts first either way.
+    struct Less {
+        const PrefixIndex* index;
+
+        template <typename A, typename B>
+        bool operator()(const A& a, const B& b) const {
+            uint64_t ha = head(a), hb = head(b);
+            if (ha != hb) return ha < hb;
+            int c = index->key(a).compare(index->key(b));
+            return c < 0 || (c == 0 && a.id < b.id);
+        }
+    };
+
+    Less less() const { return Less{ this }; }
+
+    template <typename A, typename B>
+    bool same(const A& a, const B& b) const {
+        return a.id == b.id && key(a) == key(b);
+    }
+
+    // Rebuilds the array, and the arena with it, without the tombstones.
+    void merge() {
+        std::vector<Entry> merged;
+        merged.reserve(main.size() - deadInMain + delta.size());
+        std::string packed;
+        auto keep = [&](const Entry& e) {
+            Entry copy = e;
+            copy.offset = packed.size();
+            packed.append(key(e));
+            merged.push_back(copy);
+        };
+        Less order = less();
+        auto a = main.begin();
+        auto b = delta.begin();
+        while (a != main.end() || b != delta.end()) {
+            if (a != main.end() && a->removed) {
+                ++a;
+            } else if (b == delta.end() || (a != main.end() && order(*a, *b))) {
+                keep(*a++);
+            } else {
+                keep(*b++);
+            }
+        }
+        main.swap(merged);
+        keys.swap(packed);
+        delta.clear();
+        deadInMain = 0;
+    }
+
+    std::vector<Entry> main;
+    std::vector<Entry> delta;
+    std::string keys;
+    size_t deadInMain = 0;
+};
+
+// Both name indexes, keyed by document number.
+struct NameIndex {
+    TrigramIndex trigrams;
+    PrefixIndex prefixes;
+
+    template <typename ForEach>
+    void build(ForEach forEach) {
+        trigrams.clear();
+        forEach([&](uint32_t doc, std::string_view name) { trigrams.add(doc, name); });
+        prefixes.build(forEach);
+    }
+
+    void add(uint32_t doc, std::string_view name) {
+        trigrams.add(doc, name);
+        prefixes.add(doc, name);
+    }
+
+    // Trigram postings go stale instead and are filtered by the store.
+    void remove(uint32_t doc, std::string_view name) {
+        prefixes.remove(doc, name);
+    }
+};
+
+using ContactId = uint64_t;
+
+struct ContactRecord {
+    ContactId id;
+    Contact contact;
+};
+
+struct FuzzyMatch {
+    ContactId id;
+    uint32_t distance;
+};
+
+// Borrowed fields of a stored contact, valid until the store is next changed.
+struct ContactView {
+    std::string_view name;
+    std::string_view phone;
+    std::string_view email;
+
+    ContactView() = default;
+    ContactView(std::string_view name, std::string_view phone, std::string_view email)
+        : name(name), phone(phone), email(email) {}
+    ContactView(const Contact& c) : name(c.name), phone(c.phone), email(c.email) {}
+
+    Contact toContact() const {
+        return { std::string(name), std::string(phone), std::string(email) };
+    }
+};
+
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t hashText(std::string_view text) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (char c : text) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001B3ULL;
+    }
+    return mix64(h);
+}
+
+// Open-addressing multimap from 64-bit hashes to slot numbers with linear
+// probing. Each entry is 8 bytes: the top 32 bits of the hash, which also
+// pick the bucket, and the value. Erased entries become tombstones until the
+// next rehash. Equal tags are reported to the caller, which compares the
+// real keys.
+class HashSlots {
+public:
+    void insert(uint64_t hash, uint32_t value) {
+        if ((used + 1) * 4 > slots.size() * 3) rehash();
+        uint32_t tag = tagOf(hash);
+        size_t mask = slots.size() - 1;
+        size_t i = tag & mask;
+        while (slots[i].value < Deleted) i = (i + 1) & mask;
+        if (slots[i].value == Empty) ++used;
+        slots[i] = { tag, value };
+        ++live;
+    }
+
+    bool erase(uint64_t hash, uint32_t value) {
+        if (slots.empty()) return false;
+        uint32_t tag = tagOf(hash);
+        size_t mask = slots.size() - 1;
+        for (size_t i = tag & mask; slots[i].value != Empty; i = (i + 1) & mask) {
+            if (slots[i].value == value && slots[i].tag == tag) {
+                slots[i].value = Deleted;
+                --live;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Sizes the table for count entries up front.
+    void reserve(size_t count) {
+        if ((count + 1) * 2 > slots.size()) rehash(count);
+    }
+
+    // Calls visit(value) for each entry with this hash until it returns true.
+    template <typename Visit>
+    void find(uint64_t hash, Visit visit) const {
+        if (slots.empty()) return;
+        uint32_t tag = tagOf(hash);
+        size_t mask = slots.size() - 1;
+        for (size_t i = tag & mask; slots[i].value != Empty; i = (i + 1) & mask) {
+            if (slots[i].tag == tag && slots[i].value != Deleted && visit(slots[i].value)) return;
+        }
+    }
+
+private:
+    // Values at or above Deleted are markers, not slot numbers.
+    static constexpr uint32_t Empty = UINT32_MAX;
+    static constexpr uint32_t Deleted = UINT32_MAX - 1;
+
+    struct Slot {
+        uint32_t tag;
+        uint32_t value;
+    };
+
+    static uint32_t tagOf(uint64_t hash) { return static_cast<uint32_t>(hash >> 32); }
+
+    // Resizes for the live entries only, which also drops every tombstone.
+    void rehash(size_t expected = 0) {
+        size_t capacity = 16;
+        while (capacity < (std::max(live, expected) + 1) * 2) capacity *= 2;
+        std::vector<Slot> old(capacity, Slot{ 0, Empty });
+        old.swap(slots);
+        used = live = 0;
+        size_t mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.value >= Deleted) continue;
+            size_t i = slot.tag & mask;
+            while (slots[i].value != Empty) i = (i + 1) & mask;
+            slots[i] = slot;
+            ++used;
+            ++live;
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t used = 0;  // full plus tombstones
+    size_t live = 0;
+};
+
+// Contacts addressed by stable 64-bit ids. Records sit in slots that never
+// move (freed slots are reused), an open-addressing table maps ids to slots
+// and two more give exact phone and email lookups, so add, find and delete
+// are O(1) expected.
+//
+// Field bytes live in one arena string; a slot holds the offset of its
+// name, phone and email (stored back to back) and their lengths. Edits
+// append and leave the old bytes behind, and the arena is repacked once
+// more than half of it is garbage.
+//
+// The name indexes are keyed by document numbers rather than slots: every
+// add or rename takes the next number, so posting lists only ever append.
+// Superseded numbers map to npos in docSlots and are skipped, and all
+// numbers are reassigned once stale ones outnumber the live contacts.
+class ContactStore {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+
+    // Capacity hint for loading: contacts and total field bytes.
+    void reserve(size_t contacts, size_t bytes) {
+        entries.reserve(contacts);
+        arena.reserve(bytes);
+        byId.reserve(contacts);
+        byPhone.reserve(contacts);
+        byEmail.reserve(contacts);
+    }
+
+    // The views passed in must not point into this store.
+    ContactId add(ContactView contact) {
+        ContactId id = nextId;
+        insert(id, contact);
+        return id;
+    }
+
+    // The id add() hands out next. Ids are never reused, so snapshots save
+    // it: the highest contact may have been deleted.
+    ContactId nextFreeId() const { return nextId; }
+
+    void reserveIdsBelow(ContactId id) { nextId = std::max(nextId, id); }
+
+    // Inserts under a given id (loading and replay). Fails if it is taken.
+    bool insert(ContactId id, ContactView contact) {
+        if (id == 0 || slotOf(id) != npos) return false;
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+        }
+
+        entries[slot].id = id;
+        store(slot, contact);
+        byId.insert(mix64(id), slot);
+        indexKey(byPhone, contact.phone, slot);
+        indexKey(byEmail, contact.email, slot);
+        indexName(slot);
+        ++live;
+        nextId = std::max(nextId, id + 1);
+        return true;
+    }
+
+    bool update(ContactId id, ContactView contact) {
+        uint32_t slot = slotOf(id);
+        if (slot == npos) return false;
+        ContactView old = view(slot);
+        if (old.phone != contact.phone) {
+            unindexKey(byPhone, old.phone, slot);
+            indexKey(byPhone, contact.phone, slot);
+        }
+        if (old.email != contact.email) {
+            unindexKey(byEmail, old.email, slot);
+            indexKey(byEmail, contact.email, slot);
+        }
+        bool renamed = (old.name != contact.name);
+        if (renamed) unindexName(slot);
+        release(slot);
+        store(slot, contact);
+        if (renamed) indexName(slot);
+        maybeReindex();
+        maybeRepack();
+        return true;
+    }
+
+    bool erase(ContactId id) {
+        uint32_t slot = slotOf(id);
+        if (slot == npos) return false;
+        ContactView old = view(slot);
+        unindexName(slot);
+        byId.erase(mix64(id), slot);
+        unindexKey(byPhone, old.phone, slot);
+        unindexKey(byEmail, old.email, slot);
+        release(slot);
+        entries[slot] = Entry();
+        freeSlots.push_back(slot);
+        --live;
+        maybeReindex();
+        maybeRepack();
+        return true;
+    }
+
+    std::optional<ContactView> find(ContactId id) const {
+        uint32_t slot = slotOf(id);
+        if (slot == npos) return std::nullopt;
+        return view(slot);
+    }
+
+    std::vector<ContactId> findByPhone(std::string_view phone) const {
+        return exact(byPhone, phone, &ContactView::phone);
+    }
+
+    std::vector<ContactId> findByEmail(std::string_view email) const {
+        return exact(byEmail, email, &ContactView::email);
+    }
+
+    // All ids in ascending (creation) order.
+    std::vector<ContactId> ids() const {
+        std::vector<ContactId> result;
+        result.reserve(live);
+        for (const Entry& e : entries) {
+            if (e.id) result.push_back(e.id);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    std::vector<ContactRecord> records() const {
+        std::vector<ContactRecord> result;
+        result.reserve(live);
+        for (ContactId id : ids()) result.push_back({ id, find(id)->toContact() });
+        return result;
+    }
+
+    // Contacts whose names contain the folded term.
+    std::vector<ContactId> search(const std::string& foldedTerm) const {
+        std::vector<ContactId> result;
+        if (foldedTerm.size() >= 3 && !bulkLoading) {
+            for (uint32_t doc : names.trigrams.candidates(foldedTerm)) {
+                uint32_t slot = docSlots[doc];
+                if (slot != npos && containsFolded(view(slot).name, foldedTerm)) {
+                    result.push_back(entries[slot].id);
+                }
+            }
+        } else {
+            // Too short for trigrams: scan everything
+            for (uint32_t slot = 0; slot < entries.size(); ++slot) {
+                if (entries[slot].id && containsFolded(view(slot).name, foldedTerm)) {
+                    result.push_back(entries[slot].id);
+                }
+            }
+        }
+        return result;
+    }
+
+    // Up to k contacts whose names contain the folded term with at most
+    // maxDistance typos (see FuzzyPattern), closest first. Terms longer than FuzzyPattern::maxLength find nothing.
+    //
+    // A typo breaks at most four of the term's trigrams (three, or four for
+    // a swap), so when the term has more than 4 * maxDistance distinct
+    // trigrams only contacts sharing the rest are checked; otherwise every
+    // name is.
+    std::vector<FuzzyMatch> fuzzySearch(const std::string& foldedTerm, size_t maxDistance, size_t k) const {
+        std::vector<FuzzyMatch> result;
+        if (foldedTerm.size() > FuzzyPattern::maxLength) return result;
+
+        std::vector<uint32_t> slots;
+        size_t distinct = distinctTrigrams(foldedTerm);
+        if (!bulkLoading && distinct > 4 * maxDistance) {
+            for (uint32_t doc : names.trigrams.candidatesSharing(foldedTerm, distinct - 4 * maxDistance, docSlots.size())) {
+                if (docSlots[doc] != npos) slots.push_back(docSlots[doc]);
+            }
+        } else {
+            slots.reserve(live);
+            for (uint32_t slot = 0; slot < entries.size(); ++slot) {
+                if (entries[slot].id) slots.push_back(slot);
+            }
+        }
+
+        FuzzyPattern pattern(foldedTerm);
+        const size_t lanes = FuzzyPattern::lanes;
+        for (size_t i = 0; i < slots.size(); i += lanes) {
+            std::string_view texts[lanes];
+            size_t distances[lanes];
+            size_t used = std::min(lanes, slots.size() - i);
+            for (size_t l = 0; l < used; ++l) texts[l] = view(slots[i + l]).name;
+            pattern.distances(texts, distances);
+            for (size_t l = 0; l < used; ++l) {
+                if (distances[l] <= maxDistance) {
+                    result.push_back({ entries[slots[i + l]].id, static_cast<uint32_t>(distances[l]) });
+                }
+            }
+        }
+
+        auto closer = [](const FuzzyMatch& a, const FuzzyMatch& b) {
+            return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+        };
+        if (result.size() > k) {
+            std::partial_sort(result.begin(), result.begin() + k, result.end(), closer);
+            result.resize(k);
+        } else {
+            std::sort(result.begin(), result.end(), closer);
+        }
+        return result;
+    }
+
+    // First k contacts, by folded name, whose names start with the prefix.
+    std::vector<ContactId> prefixMatches(const std::string& foldedPrefix, size_t k) const {
+        std::vector<ContactId> result;
+        for (uint32_t doc : names.prefixes.firstMatches(foldedPrefix, k)) {
+            result.push_back(entries[docSlots[doc]].id);
+        }
+        return result;
+    }
+
+    // Defers name indexing while many contacts are inserted at once.
+    void beginBulkLoad() { bulkLoading = true; }
+
+    void endBulkLoad() {
+        bulkLoading = false;
+        reindexNames();
+    }
+
+private:
+    struct Entry {
+        ContactId id = 0;  // 0 marks a free slot
+        uint64_t offset = 0;
+        uint32_t doc = npos;
+        uint32_t length[3] = {};  // name, phone, email
+    };
+
+    ContactView view(uint32_t slot) const {
+        const Entry& e = entries[slot];
+        const char* p = arena.data() + e.offset;
+        return { std::string_view(p, e.length[0]),
+                 std::string_view(p + e.length[0], e.length[1]),
+                 std::string_view(p + e.length[0] + e.length[1], e.length[2]) };
+    }
+
+    void store(uint32_t slot, ContactView contact) {
+        Entry& e = entries[slot];
+        e.offset = arena.size();
+        e.length[0] = static_cast<uint32_t>(contact.name.size());
+        e.length[1] = static_cast<uint32_t>(contact.phone.size());
+        e.length[2] = static_cast<uint32_t>(contact.email.size());
+        arena.append(contact.name);
+        arena.append(contact.phone);
+        arena.append(contact.email);
+    }
+
+    void release(uint32_t slot) {
+        const Entry& e = entries[slot];
+        garbage += size_t(e.length[0]) + e.length[1] + e.length[2];
+    }
+
+    // Copies the live fields into a fresh arena once most of it is garbage.
+    void maybeRepack() {
+        if (garbage < minRepackBytes || garbage * 2 < arena.size()) return;
+        std::string packed;
+        packed.reserve(arena.size() - garbage);
+        for (Entry& e : entries) {
+            if (!e.id) continue;
+            size_t bytes = size_t(e.length[0]) + e.length[1] + e.length[2];
+            packed.append(arena, e.offset, bytes);
+            e.offset = packed.size() - bytes;
+        }
+        arena.swap(packed);
+        garbage = 0;
+    }
+
+    static size_t distinctTrigrams(const std::string& folded) {
+        std::vector<std::string_view> grams;
+        for (size_t i = 0; i + 3 <= folded.size(); ++i) grams.push_back(std::string_view(folded).substr(i, 3));
+        std::sort(grams.begin(), grams.end());
+        return std::unique(grams.begin(), grams.end()) - grams.begin();
+    }
+
+    uint32_t slotOf(ContactId id) const {
+        uint32_t found = npos;
+        byId.find(mix64(id), [&](uint32_t slot) {
+            if (entries[slot].id != id) return false;
+            found = slot;
+            return true;
+        });
+        return found;
+    }
+
+    // Empty phones and emails are not indexed: they would all share one
+    // hash and turn the table into a single long probe chain.
+    static void indexKey(HashSlots& table, std::string_view key, uint32_t slot) {
+        if (!key.empty()) table.insert(hashText(key), slot);
+    }
+
+    static void unindexKey(HashSlots& table, std::string_view key, uint32_t slot) {
+        if (!key.empty()) table.erase(hashText(key), slot);
+    }
+
+    std::vector<ContactId> exact(const HashSlots& table, std::string_view key,
+                                 std::string_view ContactView::*field) const {
+        std::vector<ContactId> result;
+        table.find(hashText(key), [&](uint32_t slot) {
+            if (view(slot).*field == key) result.push_back(entries[slot].id);
+            return false;
+        });
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    void indexName(uint32_t slot) {
+        if (bulkLoading) return;
+        Entry& e = entries[slot];
+        e.doc = static_cast<uint32_t>(docSlots.size());
+        docSlots.push_back(slot);
+        names.add(e.doc, view(slot).name);
+    }
+
+    void unindexName(uint32_t slot) {
+        Entry& e = entries[slot];
+        if (e.doc == npos) return;
+        names.remove(e.doc, view(slot).name);
+        docSlots[e.doc] = npos;
+        e.doc = npos;
+        ++staleDocs;
+    }
+
+    void maybeReindex() {
+        if (staleDocs > std::max<size_t>(live, 1024)) reindexNames();
+    }
+
+    void reindexNames() {
+        docSlots.clear();
+        staleDocs = 0;
+        for (uint32_t slot = 0; slot < entries.size(); ++slot) {
+            if (!entries[slot].id) continue;
+            entries[slot].doc = static_cast<uint32_t>(docSlots.size());
+            docSlots.push_back(slot);
+        }
+        names.build([&](auto visit) {
+            for (uint32_t doc = 0; doc < docSlots.size(); ++doc) visit(doc, view(docSlots[doc]).name);
+        });
+    }
+
+    static constexpr size_t minRepackBytes = 1 << 16;
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeSlots;
+    size_t live = 0;
+    ContactId nextId = 1;
+    std::string arena;
+    size_t garbage = 0;  // arena bytes no longer referenced
+    HashSlots byId;
+    HashSlots byPhone;
+    HashSlots byEmail;
+
+    std::vector<uint32_t> docSlots;
+    size_t staleDocs = 0;
+    NameIndex names;
+    bool bulkLoading = false;
+};
+
+// A ContactStore shared between threads. Two copies are kept (left-right):
+// readers use whichever copy is published and never wait or take a lock,
+// while the single writer at a time edits the other copy, publishes it,
+// waits for the readers still on the old copy to leave, and then repeats the
+// edit there. A reader therefore sees one consistent version for the whole
+// call, and an edit stays O(1) instead of copying the store.
+//
+// Readers announce themselves on one of two read indicators (the version);
+// each indicator is spread over cache-line-sized counters so reader threads
+// do not contend on a single atomic.
+class ConcurrentContactStore {
+public:
+    ConcurrentContactStore() = default;
+    ConcurrentContactStore(const ConcurrentContactStore&) = delete;
+    ConcurrentContactStore& operator=(const ConcurrentContactStore&) = delete;
+
+    // Calls fn(const ContactStore&) on the current version and returns its
+    // result. Views from the store are only valid inside fn, and fn must not
+    // call write() on the same store.
+    template <typename Read>
+    auto read(Read fn) const {
+        size_t version = versionIndex.load();
+        Counter& counter = readers[version][readerSlot()];
+        counter.count.fetch_add(1);
+        struct Depart {
+            Counter& counter;
+            ~Depart() { counter.count.fetch_sub(1); }
+        } depart{ counter };
+        return fn(copies[published.load()]);
+    }
+
+    // Applies apply(ContactStore&) to both copies and returns the first
+    // result; apply must be deterministic. commit(updated, result) runs once,
+    // before readers can see the change, e.g. to journal it.
+    template <typename Apply, typename Commit>
+    auto write(Apply apply, Commit commit) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        size_t current = published.load();
+        auto result = apply(copies[1 - current]);
+        commit(static_cast<const ContactStore&>(copies[1 - current]), result);
+        published.store(1 - current);
+        waitForReaders();
+        apply(copies[current]);
+        return result;
+    }
+
+    template <typename Apply>
+    auto write(Apply apply) {
+        return write(apply, [](const ContactStore&, const auto&) {});
+    }
+
+private:
+    static constexpr size_t readerSlots = 64;
+
+    struct alignas(64) Counter {
+        std::atomic<uint64_t> count{ 0 };
+    };
+
+    static size_t readerSlot() {
+        thread_local size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % readerSlots;
+        return slot;
+    }
+
+    bool idle(size_t version) const {
+        for (const Counter& c : readers[version]) {
+            if (c.count.load() != 0) return false;
+        }
+        return true;
+    }
+
+    // Moves new readers to the other indicator and waits until no reader
+    // that might still use the unpublished copy remains on either one.
+    void waitForReaders() {
+        size_t previous = versionIndex.load();
+        size_t next = 1 - previous;
+        while (!idle(next)) std::this_thread::yield();
+        versionIndex.store(next);
+        while (!idle(previous)) std::this_thread::yield();
+    }
+
+    ContactStore copies[2];
+    std::atomic<size_t> published{ 0 };
+    std::atomic<size_t> versionIndex{ 0 };
+    mutable Counter readers[2][readerSlots];
+    std::mutex writerMutex;
+};
+
+// Snapshots written by compaction start with this header so replay knows
+// which journal records they already contain. Version 2 snapshots also store
+// each contact's id, and after the seq the next id to hand out
+// (" next=N"); older files get ids from their line order.
+//
+// Fields are separated by commas. A field containing a comma, quote or
+// newline is written in double quotes with inner quotes doubled; other
+// fields are written as they are, so files from before quoting still load.
+const std::string snapshotHeader = "#contacts-snapshot v2 seq=";
+const std::string snapshotNextId = " next=";
+const std::string legacySnapshotHeader = "#contacts-snapshot seq=";
+
+// Read-only mapping of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            size = static_cast<size_t>(st.st_size);
+            opened = true;
+            if (size > 0) {
+                void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) {
+                    opened = false;
+                    size = 0;
+                } else {
+                    data = static_cast<const char*>(p);
+                    madvise(p, size, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+
+    bool ok() const { return opened; }
+    std::string_view text() const { return { data, size }; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+};
+
+inline const char* lineEndFrom(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl : end;
+}
+
+// Reads one field at p and moves p past its separator. Unquoted fields
+// point into the file: the last one runs to the end of the line, the others
+// to the next comma. Quoted fields are unescaped into scratch and may span
+// lines, in which case lineEnd moves with them.
+bool readField(const char*& p, const char*& lineEnd, const char* end, bool last,
+               std::string& scratch, std::string_view& field) {
+    if (p < lineEnd && *p == '"') {
+        scratch.clear();
+        const char* q = p + 1;
+        for (;;) {
+            const char* quote = static_cast<const char*>(std::memchr(q, '"', end - q));
+            if (!quote) return false;
+            scratch.append(q, quote);
+            if (quote + 1 < end && quote[1] == '"') {
+                scratch.push_back('"');
+                q = quote + 2;
+                continue;
+            }
+            p = quote + 1;
+            break;
+        }
+        if (p > lineEnd) lineEnd = lineEndFrom(p, end);
+        field = scratch;
+    } else {
+        const char* stop = last ? lineEnd : static_cast<const char*>(std::memchr(p, ',', lineEnd - p));
+        if (!stop) return false;
+        field = std::string_view(p, stop - p);
+        p = stop;
+    }
+
+    if (last) return p == lineEnd;
+    if (p == lineEnd || *p != ',') return false;
+    ++p;
+    return true;
+}
+
+// Loads the snapshot straight into the store; lines that do not parse are
+// skipped. Returns the journal sequence number the snapshot covers (0 for
+// old files).
+uint64_t loadContacts(const std::string& filename, ContactStore& contacts) {
+    MappedFile file(filename);
+    if (!file.ok()) {
         std::cout << "No existing contacts found.\n";
-        return;
+        return 0;
     }
+    std::string_view text = file.text();
+    const char* p = text.data();
+    const char* end = p + text.size();
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        Contact c;
-        if (std::getline(ss, c.name, ',') &&
-            std::getline(ss, c.phone, ',') &&
-            std::getline(ss, c.email)) {
-            contacts.push_back(c);
+    uint64_t seq = 0;
+    bool withIds = false;
+    std::string_view firstLine(p, lineEndFrom(p, end) - p);
+    for (const std::string* header : { &snapshotHeader, &legacySnapshotHeader }) {
+        if (firstLine.compare(0, header->size(), *header) == 0) {
+            const char* lineEnd = firstLine.data() + firstLine.size();
+            const char* rest = std::from_chars(firstLine.data() + header->size(), lineEnd, seq).ptr;
+            withIds = (header == &snapshotHeader);
+            std::string_view tail(rest, lineEnd - rest);
+            ContactId next = 0;
+            if (withIds && tail.compare(0, snapshotNextId.size(), snapshotNextId) == 0 &&
+                std::from_chars(rest + snapshotNextId.size(), lineEnd, next).ec == std::errc()) {
+                contacts.reserveIdsBelow(next);
+            }
+            p = std::min(end, firstLine.data() + firstLine.size() + 1);
+            break;
         }
     }
+
+    size_t lines = 0;
+    for (const char* q = p; q < end; q = lineEndFrom(q, end) + 1) ++lines;
+    contacts.reserve(lines, text.size());
+
+    const size_t fieldCount = withIds ? 4 : 3;
+    std::string scratch[4];
+    std::string_view fields[4];
+    ContactId nextLineId = 1;
+    while (p < end) {
+        const char* lineEnd = lineEndFrom(p, end);
+        const char* skipTo = lineEnd;
+        bool parsed = true;
+        for (size_t f = 0; f < fieldCount && parsed; ++f) {
+            parsed = readField(p, lineEnd, end, f + 1 == fieldCount, scratch[f], fields[f]);
+        }
+
+        ContactId id = nextLineId;
+        if (parsed && withIds) {
+            auto result = std::from_chars(fields[0].data(), fields[0].data() + fields[0].size(), id);
+            parsed = (result.ec == std::errc());
+        }
+        if (parsed) {
+            const std::string_view* c = fields + (fieldCount - 3);
+            contacts.insert(id, ContactView(c[0], c[1], c[2]));
+            ++nextLineId;
+            skipTo = lineEnd;
+        }
+        p = std::min(end, skipTo + 1);
+    }
+    return seq;
 }
 
-void saveContacts(const std::string& filename, const std::vector<Contact>& contacts) {
-    std::ofstream file(filename);
-    if (!file) {
-        std::cerr << "Error saving contacts!\n";
+void writeField(std::ostream& out, std::string_view field) {
+    if (field.find_first_of(",\"\n") == std::string_view::npos) {
+        out << field;
         return;
     }
+    out << '"';
+    for (char c : field) {
+        if (c == '"') out << '"';
+        out << c;
+    }
+    out << '"';
+}
+
+void syncDirectoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+// Writes a full snapshot to a temporary file and renames it into place, so a
+// crash leaves either the old or the new snapshot, never a truncated one.
+bool saveContacts(const std::string& filename, const std::vector<ContactRecord>& records, uint64_t seq,
+                  ContactId nextId) {
+    const std::string tmp = filename + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Error saving contacts!\n";
+            return false;
+        }
+
+        file << snapshotHeader << seq << snapshotNextId << nextId << "\n";
+        for (const auto& r : records) {
+            file << r.id;
+            for (const std::string* field : { &r.contact.name, &r.contact.phone, &r.contact.email }) {
+                file << ',';
+                writeField(file, *field);
+            }
+            file << '\n';
+        }
+        if (!file.flush()) {
+            std::cerr << "Error saving contacts!\n";
+            return false;
+        }
+    }
+
+    int fd = ::open(tmp.c_str(), O_RDONLY);
+    bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    if (!synced || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Error saving contacts!\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    syncDirectoryOf(filename);
+    return true;
+}
 
-    for (const auto& c : contacts) {
-        file << c.name << "," << c.phone << "," << c.email << "\n";
+uint32_t crc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = true;
     }
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFU;
 }
 
-void addContact(std::vector<Contact>& contacts) {
+// Append-only operation log next to the snapshot. Each edit appends one
+// checksummed record (O(1) I/O); the snapshot is rewritten by a background
+// compaction once the log holds about as many records as there are contacts.
+//
+// Record: u32 payload length, u32 crc32(payload), payload =
+//   u64 seq, u8 op, u64 contact id, then for add/update three
+//   (u32 length, bytes) fields: name, phone, email.
+// Logs from before contact ids used ops 1-3 with a u32 list position
+// instead; those are still replayed, then folded into a new snapshot.
+//
+// Compaction renames the log to "<log>.old", starts a fresh log and writes
+// the snapshot from a copy on another thread; the old log is removed once the
+// new snapshot is durable; while an old log is still there after a failed
+// snapshot, compaction only retries the snapshot. Replay skips records whose
+// seq the snapshot covers, so a crash at any step recovers correctly.
+class ContactJournal {
+public:
+    enum Op : uint8_t {
+        LegacyAdd = 1, LegacyUpdate = 2, LegacyDelete = 3,
+        Add = 4, Update = 5, Delete = 6
+    };
+
+    explicit ContactJournal(const std::string& snapshotFile)
+        : snapshotPath(snapshotFile), logPath(snapshotFile + ".log"), oldLogPath(snapshotFile + ".log.old") {}
+
+    ContactJournal(const ContactJournal&) = delete;
+    ContactJournal& operator=(const ContactJournal&) = delete;
+
+    ~ContactJournal() {
+        if (compactor.joinable()) compactor.join();
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Snapshot plus log replay. Truncates a torn record at the end of the log.
+    void load(ContactStore& contacts) {
+        contacts.beginBulkLoad();
+        snapshotSeq = loadContacts(snapshotPath, contacts);
+        lastSeq = snapshotSeq;
+
+        legacyOrder.clear();
+        replayedLegacy = false;
+        bool leftover = (::access(oldLogPath.c_str(), F_OK) == 0);
+        if (leftover) replay(oldLogPath, contacts);
+        size_t validBytes = replay(logPath, contacts);
+        contacts.endBulkLoad();
+
+        fd = ::open(logPath.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) {
+            std::cerr << "Error opening contact journal!\n";
+            return;
+        }
+        if (ftruncate(fd, static_cast<off_t>(validBytes)) != 0 ||
+            lseek(fd, 0, SEEK_END) < 0) {
+            std::cerr << "Error repairing contact journal!\n";
+        }
+
+        // A compaction was interrupted, or the log still uses list positions:
+        // fold everything into a fresh snapshot before the log is discarded.
+        if ((leftover || replayedLegacy) && saveContacts(snapshotPath, contacts.records(), lastSeq, contacts.nextFreeId())) {
+            std::remove(oldLogPath.c_str());
+            if (ftruncate(fd, 0) == 0) lseek(fd, 0, SEEK_SET);
+            snapshotSeq = lastSeq;
+            pending = 0;
+        }
+    }
+
+    void recordAdd(ContactId id, const Contact& c) { append(Add, id, &c); }
+    void recordUpdate(ContactId id, const Contact& c) { append(Update, id, &c); }
+    void recordDelete(ContactId id) { append(Delete, id, nullptr); }
+
+    // Starts a background compaction when the log has grown past the
+    // snapshot size; amortized O(1) per edit.
+    void maybeCompact(const ContactStore& contacts) {
+        if (pending < std::max<size_t>(minCompactRecords, contacts.size())) return;
+        if (compacting.load()) return;
+        if (compactor.joinable()) compactor.join();
+
+        // A failed snapshot leaves the old log behind, holding edits no
+        // snapshot has yet; renaming over it would lose them. Retry the
+        // snapshot instead (the contacts include those edits) and keep
+        // appending to the current log until the old one is gone.
+        if (::access(oldLogPath.c_str(), F_OK) != 0) {
+            if (std::rename(logPath.c_str(), oldLogPath.c_str()) != 0) return;
+
+            ::close(fd);
+            fd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                std::cerr << "Error opening contact journal!\n";
+                return;
+            }
+            syncDirectoryOf(logPath);
+        }
+
+        pending = 0;
+        compacting = true;
+        compactor = std::thread([this, copy = contacts.records(), seq = lastSeq, next = contacts.nextFreeId()]() {
+            if (saveContacts(snapshotPath, copy, seq, next)) std::remove(oldLogPath.c_str());
+            compacting = false;
+        });
+    }
+
+private:
+    static constexpr size_t minCompactRecords = 1024;
+
+    static void putU32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+
+    static void putU64(std::string& out, uint64_t v) {
+        for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+
+    static uint64_t getLE(const uint8_t* p, int bytes) {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+        return v;
+    }
+
+    void append(Op op, ContactId id, const Contact* c) {
+        std::string payload;
+        putU64(payload, ++lastSeq);
+        payload.push_back(static_cast<char>(op));
+        putU64(payload, id);
+        if (c) {
+            for (const std::string* field : { &c->name, &c->phone, &c->email }) {
+                putU32(payload, static_cast<uint32_t>(field->size()));
+                payload += *field;
+            }
+        }
+
+        std::string record;
+        putU32(record, static_cast<uint32_t>(payload.size()));
+        putU32(record, crc32(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()));
+        record += payload;
+
+        // One write per record keeps it contiguous; fdatasync makes it durable
+        // before the edit is acknowledged.
+        if (fd < 0 || ::write(fd, record.data(), record.size()) != static_cast<ssize_t>(record.size()) ||
+            fdatasync(fd) != 0) {
+            std::cerr << "Error writing contact journal!\n";
+            return;
+        }
+        ++pending;
+    }
+
+    // Applies valid records newer than the snapshot; returns the byte length
+    // of the valid prefix.
+    size_t replay(const std::string& path, ContactStore& contacts) {
+        std::ifstream file(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+
+        size_t pos = 0;
+        while (pos + 8 <= data.size()) {
+            uint32_t length = static_cast<uint32_t>(getLE(bytes + pos, 4));
+            uint32_t crc = static_cast<uint32_t>(getLE(bytes + pos + 4, 4));
+            if (length < 13 || length > data.size() - pos - 8 || crc32(bytes + pos + 8, length) != crc) break;
+            if (!apply(bytes + pos + 8, length, contacts)) break;
+            pos += 8 + length;
+            ++pending;
+        }
+        return pos;
+    }
+
+    bool apply(const uint8_t* p, size_t length, ContactStore& contacts) {
+        const uint8_t* end = p + length;
+        uint64_t seq = getLE(p, 8);
+        uint8_t op = p[8];
+        bool legacy = (op >= LegacyAdd && op <= LegacyDelete);
+        size_t keyBytes = legacy ? 4 : 8;
+        if (length < 9 + keyBytes) return false;
+        uint64_t key = getLE(p + 9, static_cast<int>(keyBytes));
+        p += 9 + keyBytes;
+
+        Contact c;
+        if (op == Add || op == Update || op == LegacyAdd || op == LegacyUpdate) {
+            for (std::string* field : { &c.name, &c.phone, &c.email }) {
+                if (end - p < 4) return false;
+                size_t n = static_cast<size_t>(getLE(p, 4));
+                p += 4;
+                if (static_cast<size_t>(end - p) < n) return false;
+                field->assign(reinterpret_cast<const char*>(p), n);
+                p += n;
+            }
+        }
+
+        if (seq <= lastSeq) return true; // already in the snapshot
+        if (legacy) {
+            // Positions refer to the list in id order, which is how legacy
+            // snapshots were numbered.
+            if (!replayedLegacy) legacyOrder = contacts.ids();
+            replayedLegacy = true;
+            if (op != LegacyAdd && key >= legacyOrder.size()) return false;
+        }
+
+        switch (op) {
+            case Add:
+                if (!contacts.insert(key, c)) return false;
+                break;
+            case Update:
+                if (!contacts.update(key, c)) return false;
+                break;
+            case Delete:
+                if (!contacts.erase(key)) return false;
+                break;
+            case LegacyAdd:
+                if (key != legacyOrder.size()) return false;
+                legacyOrder.push_back(contacts.add(c));
+                break;
+            case LegacyUpdate:
+                contacts.update(legacyOrder[key], c);
+                break;
+            case LegacyDelete:
+                contacts.erase(legacyOrder[key]);
+                legacyOrder.erase(legacyOrder.begin() + static_cast<std::ptrdiff_t>(key));
+                break;
+            default:
+                return false;
+        }
+        lastSeq = seq;
+        return true;
+    }
+
+    std::string snapshotPath;
+    std::string logPath;
+    std::string oldLogPath;
+    int fd = -1;
+    uint64_t snapshotSeq = 0;
+    uint64_t lastSeq = 0;
+    size_t pending = 0;
+    std::vector<ContactId> legacyOrder;  // positions used by legacy records
+    bool replayedLegacy = false;
+    std::atomic<bool> compacting{ false };
+    std::thread compactor;
+};
+
+void addContact(ConcurrentContactStore& contacts, ContactJournal& journal) {
     Contact c;
     std::cout << "Enter name: ";
     std::getline(std::cin, c.name);
@@ -51,72 +1787,165 @@ void addContact(std::vector<Contact>& contacts) {
     std::cout << "Enter email: ";
     std::getline(std::cin, c.email);
 
-    contacts.push_back(c);
-    std::cout << "Contact added.\n";
+    ContactId id = contacts.write(
+        [&](ContactStore& s) { return s.add(c); },
+        [&](const ContactStore& s, ContactId added) {
+            journal.recordAdd(added, c);
+            journal.maybeCompact(s);
+        });
+    std::cout << "Contact added with ID " << id << ".\n";
+}
+
+void printContact(ContactId id, const ContactView& c) {
+    std::cout << id << ". " << c.name
+              << ", Phone: " << c.phone
+              << ", Email: " << c.email << "\n";
+}
+
+bool isEmpty(const ConcurrentContactStore& contacts) {
+    return contacts.read([](const ContactStore& s) { return s.empty(); });
+}
+
+void printContacts(const ContactStore& contacts, const std::vector<ContactId>& ids) {
+    for (ContactId id : ids) printContact(id, *contacts.find(id));
 }
 
-void listContacts(const std::vector<Contact>& contacts) {
-    if (contacts.empty()) {
+void listContacts(const ConcurrentContactStore& contacts) {
+    if (isEmpty(contacts)) {
         std::cout << "No contacts to show.\n";
         return;
     }
     std::cout << "\nContacts:\n";
-    for (size_t i = 0; i < contacts.size(); ++i) {
-        std::cout << i + 1 << ". " << contacts[i].name
-                  << ", Phone: " << contacts[i].phone
-                  << ", Email: " << contacts[i].email << "\n";
-    }
+    contacts.read([](const ContactStore& s) {
+        printContacts(s, s.ids());
+        return true;
+    });
 }
 
-// Helper to convert string to lowercase (for case-insensitive search)
-std::string toLower(const std::string& str) {
-    std::string result = str;
-    std::transform(result.begin(), result.end(), result.begin(),
-                   [](unsigned char c) { return std::tolower(c); });
-    return result;
+void searchContacts(const ConcurrentContactStore& contacts) {
+    if (isEmpty(contacts)) {
+        std::cout << "No contacts to search.\n";
+        return;
+    }
+
+    std::cout << "Enter search term (name): ";
+    std::string term;
+    std::getline(std::cin, term);
+    term = foldCase(term);
+
+    bool found = contacts.read([&](const ContactStore& s) {
+        std::vector<ContactId> matches = s.search(term);
+        printContacts(s, matches);
+        return !matches.empty();
+    });
+    if (!found) {
+        std::cout << "No contacts matched the search.\n";
+    }
 }
 
-void searchContacts(const std::vector<Contact>& contacts) {
-    if (contacts.empty()) {
+void fuzzySearchContacts(const ConcurrentContactStore& contacts) {
+    if (isEmpty(contacts)) {
         std::cout << "No contacts to search.\n";
         return;
     }
 
-    std::cout << "Enter search term (name): ";
+    std::cout << "Enter search term (name, typos allowed): ";
     std::string term;
     std::getline(std::cin, term);
-    term = toLower(term);
+    term = foldCase(term);
+    if (term.size() > FuzzyPattern::maxLength) {
+        std::cout << "Search term is too long for fuzzy search.\n";
+        return;
+    }
 
-    bool found = false;
-    for (size_t i = 0; i < contacts.size(); ++i) {
-        if (toLower(contacts[i].name).find(term) != std::string::npos) {
-            std::cout << i + 1 << ". " << contacts[i].name
-                      << ", Phone: " << contacts[i].phone
-                      << ", Email: " << contacts[i].email << "\n";
-            found = true;
+    // Up to two typos, fewer for short terms
+    const size_t maxDistance = term.size() < 3 ? 0 : term.size() < 6 ? 1 : 2;
+    const size_t maxResults = 20;
+    bool found = contacts.read([&](const ContactStore& s) {
+        std::vector<FuzzyMatch> matches = s.fuzzySearch(term, maxDistance, maxResults);
+        for (const FuzzyMatch& m : matches) {
+            std::cout << "(" << m.distance << (m.distance == 1 ? " typo) " : " typos) ");
+            printContact(m.id, *s.find(m.id));
         }
-    }
+        return !matches.empty();
+    });
     if (!found) {
         std::cout << "No contacts matched the search.\n";
     }
 }
 
-void editContact(std::vector<Contact>& contacts) {
-    if (contacts.empty()) {
+void prefixLookup(const ConcurrentContactStore& contacts) {
+    if (isEmpty(contacts)) {
+        std::cout << "No contacts to search.\n";
+        return;
+    }
+
+    std::cout << "Enter name prefix: ";
+    std::string prefix;
+    std::getline(std::cin, prefix);
+
+    const size_t maxSuggestions = 10;
+    std::string folded = foldCase(prefix);
+    bool found = contacts.read([&](const ContactStore& s) {
+        std::vector<ContactId> matches = s.prefixMatches(folded, maxSuggestions);
+        printContacts(s, matches);
+        return !matches.empty();
+    });
+    if (!found) {
+        std::cout << "No contacts start with \"" << prefix << "\".\n";
+    }
+}
+
+void findByPhoneOrEmail(const ConcurrentContactStore& contacts) {
+    if (isEmpty(contacts)) {
+        std::cout << "No contacts to search.\n";
+        return;
+    }
+
+    std::cout << "Enter phone or email: ";
+    std::string key;
+    std::getline(std::cin, key);
+
+    bool found = contacts.read([&](const ContactStore& s) {
+        std::vector<ContactId> matches = s.findByPhone(key);
+        for (ContactId id : s.findByEmail(key)) matches.push_back(id);
+        printContacts(s, matches);
+        return !matches.empty();
+    });
+    if (!found) {
+        std::cout << "No contact has that phone or email.\n";
+    }
+}
+
+// Reads a contact ID; returns 0 if the input was not a number.
+ContactId readContactId(const std::string& prompt) {
+    std::cout << prompt;
+    ContactId id = 0;
+    if (!(std::cin >> id)) {
+        std::cin.clear();
+        id = 0;
+    }
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    return id;
+}
+
+void editContact(ConcurrentContactStore& contacts, ContactJournal& journal) {
+    if (isEmpty(contacts)) {
         std::cout << "No contacts to edit.\n";
         return;
     }
-    listContacts(contacts);
-    std::cout << "Enter the number of the contact to edit: ";
-    size_t index;
-    std::cin >> index;
-    std::cin.ignore();
-    if (index == 0 || index > contacts.size()) {
-        std::cout << "Invalid contact number.\n";
+    ContactId id = readContactId("Enter the ID of the contact to edit: ");
+    std::optional<Contact> current = contacts.read([&](const ContactStore& s) -> std::optional<Contact> {
+        std::optional<ContactView> view = s.find(id);
+        if (!view) return std::nullopt;
+        return view->toContact();
+    });
+    if (!current) {
+        std::cout << "Invalid contact ID.\n";
         return;
     }
 
-    Contact& c = contacts[index - 1];
+    Contact c = *current;
     std::cout << "Editing contact: " << c.name << "\n";
 
     std::cout << "Enter new name (or leave empty to keep \"" << c.name << "\"): ";
@@ -132,33 +1961,52 @@ void editContact(std::vector<Contact>& contacts) {
     std::getline(std::cin, input);
     if (!input.empty()) c.email = input;
 
-    std::cout << "Contact updated.\n";
+    // Someone else may have deleted it in the meantime.
+    bool updated = contacts.write(
+        [&](ContactStore& s) { return s.update(id, c); },
+        [&](const ContactStore& s, bool ok) {
+            if (!ok) return;
+            journal.recordUpdate(id, c);
+            journal.maybeCompact(s);
+        });
+    std::cout << (updated ? "Contact updated.\n" : "Contact no longer exists.\n");
 }
 
-void deleteContact(std::vector<Contact>& contacts) {
-    if (contacts.empty()) {
+void deleteContact(ConcurrentContactStore& contacts, ContactJournal& journal) {
+    if (isEmpty(contacts)) {
         std::cout << "No contacts to delete.\n";
         return;
     }
-    listContacts(contacts);
-    std::cout << "Enter the number of the contact to delete: ";
-    size_t index;
-    std::cin >> index;
-    std::cin.ignore();
-    if (index == 0 || index > contacts.size()) {
-        std::cout << "Invalid contact number.\n";
+    ContactId id = readContactId("Enter the ID of the contact to delete: ");
+    bool erased = contacts.write(
+        [&](ContactStore& s) { return s.erase(id); },
+        [&](const ContactStore& s, bool ok) {
+            if (!ok) return;
+            journal.recordDelete(id);
+            journal.maybeCompact(s);
+        });
+    if (!erased) {
+        std::cout << "Invalid contact ID.\n";
         return;
     }
-
-    contacts.erase(contacts.begin() + index - 1);
     std::cout << "Contact deleted.\n";
 }
 
 int main() {
-    std::vector<Contact> contacts;
+    ConcurrentContactStore contacts;
     const std::string filename = "contacts.txt";
 
-    loadContacts(filename, contacts);
+    // Edits are appended to contacts.txt.log; contacts.txt is only rewritten
+    // by compaction.
+    ContactJournal journal(filename);
+    {
+        ContactStore loaded;
+        journal.load(loaded);
+        contacts.write([&](ContactStore& s) {
+            s = loaded;
+            return true;
+        });
+    }
 
     char choice;
     do {
@@ -166,6 +2014,9 @@ int main() {
         std::cout << "a) Add Contact\n";
         std::cout << "l) List Contacts\n";
         std::cout << "s) Search Contacts\n";
+        std::cout << "z) Fuzzy Search\n";
+        std::cout << "p) Prefix Lookup\n";
+        std::cout << "f) Find by Phone/Email\n";
         std::cout << "e) Edit Contact\n";
         std::cout << "d) Delete Contact\n";
         std::cout << "q) Quit\n";
@@ -176,8 +2027,7 @@ int main() {
         switch (choice) {
             case 'a':
             case 'A':
-                addContact(contacts);
-                saveContacts(filename, contacts);
+                addContact(contacts, journal);
                 break;
             case 'l':
             case 'L':
@@ -187,15 +2037,25 @@ int main() {
             case 'S':
                 searchContacts(contacts);
                 break;
+            case 'z':
+            case 'Z':
+                fuzzySearchContacts(contacts);
+                break;
+            case 'p':
+            case 'P':
+                prefixLookup(contacts);
+                break;
+            case 'f':
+            case 'F':
+                findByPhoneOrEmail(contacts);
+                break;
             case 'e':
             case 'E':
-                editContact(contacts);
-                saveContacts(filename, contacts);
+                editContact(contacts, journal);
                 break;
             case 'd':
             case 'D':
-                deleteContact(contacts);
-                saveContacts(filename, contacts);
+                deleteContact(contacts, journal);
                 break;
             case 'q':
             case 'Q':
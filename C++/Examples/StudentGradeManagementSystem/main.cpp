@@ -6,6 +6,19 @@
 #include <iomanip>
 #include <algorithm>
 #include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <charconv>
+#include <cerrno>
+#include <cstdlib>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 struct Student {
     std::string name;
@@ -41,6 +54,364 @@ double stddev(const std::vector<double>& v) {
     return std::sqrt(variance);
 }
 
+// Maps a double to an unsigned key with the same ordering, so averages can be
+// radix sorted as plain integers.
+uint64_t orderedKey(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return (bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+// Precomputed sort key: the average is computed once per student instead of
+// twice per comparison.
+struct SortKey {
+    uint64_t key;
+    uint32_t index;
+};
+
+std::vector<SortKey> averageKeys(const std::vector<Student>& students, bool descending) {
+    std::vector<SortKey> keys(students.size());
+    for (size_t i = 0; i < students.size(); ++i) {
+        uint64_t key = orderedKey(students[i].average());
+        keys[i] = { descending ? ~key : key, static_cast<uint32_t>(i) };
+    }
+    return keys;
+}
+
+// Stable LSD radix sort, one byte per pass. Passes where every key shares the
+// same byte (sign and exponent for grades in 0..100) are skipped.
+void radixSortKeys(std::vector<SortKey>& keys) {
+    const size_t n = keys.size();
+    if (n < 64) {
+        std::stable_sort(keys.begin(), keys.end(), [](const SortKey& a, const SortKey& b) {
+            return a.key < b.key;
+        });
+        return;
+    }
+
+    size_t counts[8][256] = {};
+    for (const auto& k : keys) {
+        for (int b = 0; b < 8; ++b) ++counts[b][(k.key >> (8 * b)) & 0xFF];
+    }
+
+    std::vector<SortKey> buffer(n);
+    SortKey* src = keys.data();
+    SortKey* dst = buffer.data();
+    for (int b = 0; b < 8; ++b) {
+        size_t* count = counts[b];
+        const int shift = 8 * b;
+        if (count[(src[0].key >> shift) & 0xFF] == n) continue;
+
+        size_t offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            dst[count[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != keys.data()) std::memcpy(keys.data(), src, n * sizeof(SortKey));
+}
+
+// Sort descending by average; ties keep their input order.
+void sortByAverage(std::vector<Student>& students) {
+    std::vector<SortKey> keys = averageKeys(students, true);
+    radixSortKeys(keys);
+
+    std::vector<Student> sorted;
+    sorted.reserve(students.size());
+    for (const auto& k : keys) sorted.push_back(std::move(students[k.index]));
+    students.swap(sorted);
+}
+
+// Indices of the k highest (or lowest) averages, best first. Uses a bounded
+// heap of size k, so it is O(n log k) and never sorts the whole class.
+template <typename AverageAt>
+std::vector<size_t> rankBy(size_t n, size_t k, bool highest, AverageAt averageAt) {
+    auto worse = [](const SortKey& a, const SortKey& b) {
+        return a.key < b.key || (a.key == b.key && a.index < b.index);
+    };
+    std::priority_queue<SortKey, std::vector<SortKey>, decltype(worse)> heap(worse);
+
+    k = std::min(k, n);
+    if (k == 0) return {};
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t key = orderedKey(averageAt(i));
+        // Smaller key ranks first; earlier index wins ties.
+        SortKey candidate{ highest ? ~key : key, static_cast<uint32_t>(i) };
+        if (heap.size() < k) {
+            heap.push(candidate);
+        } else if (worse(candidate, heap.top())) {
+            heap.pop();
+            heap.push(candidate);
+        }
+    }
+
+    std::vector<size_t> result(heap.size());
+    for (size_t i = result.size(); i-- > 0; heap.pop()) result[i] = heap.top().index;
+    return result;
+}
+
+// Order-statistics treap over (descending average key, student id). Node i
+// belongs to student i, so the tree allocates nothing beyond one slot per
+// student; insert, erase and rank are O(log n) expected.
+class RankTree {
+public:
+    void insert(uint32_t id, uint64_t key) {
+        if (id >= nodes.size()) nodes.resize(id + 1);
+        Node& n = nodes[id];
+        n.key = key;
+        n.priority = mix(id);
+        n.left = n.right = nil;
+        n.size = 1;
+        root = insertAt(root, id);
+    }
+
+    void erase(uint32_t id) {
+        root = eraseAt(root, id);
+    }
+
+    size_t size() const { return sizeOf(root); }
+
+    // Number of students ranked ahead of id.
+    size_t countBefore(uint32_t id) const {
+        size_t count = 0;
+        uint32_t t = root;
+        while (t != id) {
+            if (less(id, t)) {
+                t = nodes[t].left;
+            } else {
+                count += sizeOf(nodes[t].left) + 1;
+                t = nodes[t].right;
+            }
+        }
+        return count + sizeOf(nodes[id].left);
+    }
+
+    // Visits the first k ids in rank order, or the last k when reverse is set,
+    // in O(log n + k).
+    template <typename Visit>
+    void visit(size_t k, bool reverse, Visit visitor) const {
+        std::vector<uint32_t> stack;
+        uint32_t t = root;
+        while ((t != nil || !stack.empty()) && k > 0) {
+            while (t != nil) {
+                stack.push_back(t);
+                t = reverse ? nodes[t].right : nodes[t].left;
+            }
+            t = stack.back();
+            stack.pop_back();
+            visitor(t);
+            --k;
+            t = reverse ? nodes[t].left : nodes[t].right;
+        }
+    }
+
+private:
+    static constexpr uint32_t nil = UINT32_MAX;
+
+    struct Node {
+        uint64_t key = 0;
+        uint32_t priority = 0;
+        uint32_t left = nil;
+        uint32_t right = nil;
+        uint32_t size = 0;
+    };
+
+    static uint32_t mix(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        return x ^ (x >> 16);
+    }
+
+    uint32_t sizeOf(uint32_t t) const { return t == nil ? 0 : nodes[t].size; }
+
+    void update(uint32_t t) {
+        nodes[t].size = sizeOf(nodes[t].left) + sizeOf(nodes[t].right) + 1;
+    }
+
+    bool less(uint32_t a, uint32_t b) const {
+        return nodes[a].key < nodes[b].key || (nodes[a].key == nodes[b].key && a < b);
+    }
+
+    // Splits t into entries ranked before pivot and the rest.
+    void split(uint32_t t, uint32_t pivot, uint32_t& left, uint32_t& right) {
+        if (t == nil) {
+            left = right = nil;
+        } else if (less(t, pivot)) {
+            split(nodes[t].right, pivot, nodes[t].right, right);
+            left = t;
+            update(t);
+        } else {
+            split(nodes[t].left, pivot, left, nodes[t].left);
+            right = t;
+            update(t);
+        }
+    }
+
+    uint32_t merge(uint32_t a, uint32_t b) {
+        if (a == nil) return b;
+        if (b == nil) return a;
+        if (nodes[a].priority > nodes[b].priority) {
+            nodes[a].right = merge(nodes[a].right, b);
+            update(a);
+            return a;
+        }
+        nodes[b].left = merge(a, nodes[b].left);
+        update(b);
+        return b;
+    }
+
+    uint32_t insertAt(uint32_t t, uint32_t id) {
+        if (t == nil) return id;
+        if (nodes[id].priority > nodes[t].priority) {
+            split(t, id, nodes[id].left, nodes[id].right);
+            update(id);
+            return id;
+        }
+        if (less(id, t)) nodes[t].left = insertAt(nodes[t].left, id);
+        else nodes[t].right = insertAt(nodes[t].right, id);
+        update(t);
+        return t;
+    }
+
+    uint32_t eraseAt(uint32_t t, uint32_t id) {
+        if (t == id) return merge(nodes[t].left, nodes[t].right);
+        if (less(id, t)) nodes[t].left = eraseAt(nodes[t].left, id);
+        else nodes[t].right = eraseAt(nodes[t].right, id);
+        update(t);
+        return t;
+    }
+
+    std::vector<Node> nodes;
+    uint32_t root = nil;
+};
+
+// Students plus statistics that are maintained as data changes, so reports
+// only pay for what was edited since the last one.
+class GradeBook {
+public:
+    const std::vector<Student>& students() const { return roster; }
+    size_t size() const { return roster.size(); }
+    bool empty() const { return roster.empty(); }
+
+    // Replaces everything, e.g. after loading a file. O(total grades).
+    void assign(std::vector<Student> students) {
+        clear();
+        reserve(students.size());
+        for (auto& s : students) addStudent(std::move(s));
+    }
+
+    void clear() {
+        roster.clear();
+        stats.clear();
+        byName.clear();
+        ranking = RankTree();
+    }
+
+    void reserve(size_t students) {
+        roster.reserve(students);
+        stats.reserve(students);
+        byName.reserve(students);
+    }
+
+    size_t addStudent(Student student) {
+        return addStudent(std::move(student.name), student.grades.data(), student.grades.size());
+    }
+
+    // Adds a student whose grades are read from grades[0, count), so a caller
+    // holding them elsewhere (e.g. a mapped snapshot) need not copy them first.
+    size_t addStudent(std::string name, const double* grades, size_t count) {
+        size_t id = roster.size();
+        roster.push_back(Student{ std::move(name), {} });
+        roster[id].grades.reserve(count);
+        stats.emplace_back();
+        byName.emplace(roster[id].name, id);
+        for (size_t g = 0; g < count; ++g) appendGrade(id, grades[g]);
+        ranking.insert(static_cast<uint32_t>(id), rankKey(id));
+        return id;
+    }
+
+    // O(1) amortized for the per-student stats plus O(log n) to re-rank.
+    void addGrade(size_t id, double grade) {
+        ranking.erase(static_cast<uint32_t>(id));
+        appendGrade(id, grade);
+        ranking.insert(static_cast<uint32_t>(id), rankKey(id));
+    }
+
+    // First student with this name, or size() if there is none.
+    size_t find(const std::string& name) const {
+        auto it = byName.find(name);
+        return it == byName.end() ? roster.size() : it->second;
+    }
+
+    double average(size_t id) const {
+        const CachedStats& st = stats[id];
+        return st.count ? st.sum / st.count : 0.0;
+    }
+
+    double stddev(size_t id) const {
+        const CachedStats& st = stats[id];
+        return st.count < 2 ? 0.0 : std::sqrt(st.m2 / (st.count - 1));
+    }
+
+    // Recomputed only for students whose grades changed since the last call.
+    double median(size_t id) const {
+        const CachedStats& st = stats[id];
+        if (st.medianDirty) {
+            st.median = ::median(roster[id].grades);
+            st.medianDirty = false;
+        }
+        return st.median;
+    }
+
+    // 1-based class rank by average, highest first.
+    size_t rank(size_t id) const {
+        return ranking.countBefore(static_cast<uint32_t>(id)) + 1;
+    }
+
+    // Ids of the k highest (or lowest) averages, best first.
+    std::vector<size_t> ranked(size_t k, bool highest) const {
+        std::vector<size_t> ids;
+        ids.reserve(std::min(k, roster.size()));
+        ranking.visit(k, !highest, [&](uint32_t id) { ids.push_back(id); });
+        return ids;
+    }
+
+private:
+    struct CachedStats {
+        size_t count = 0;
+        double sum = 0;    // summed in insertion order, like Student::average
+        double m2 = 0;     // Welford's running sum of squared deviations
+        mutable double median = 0;
+        mutable bool medianDirty = false;
+    };
+
+    void appendGrade(size_t id, double grade) {
+        CachedStats& st = stats[id];
+        double oldMean = st.count ? st.sum / st.count : 0.0;
+        st.sum += grade;
+        st.count++;
+        st.m2 += (grade - oldMean) * (grade - st.sum / st.count);
+        st.medianDirty = true;
+        roster[id].grades.push_back(grade);
+    }
+
+    uint64_t rankKey(size_t id) const {
+        return ~orderedKey(average(id));
+    }
+
+    std::vector<Student> roster;
+    std::vector<CachedStats> stats;
+    std::unordered_map<std::string, size_t> byName;
+    RankTree ranking;
+};
+
 int getInt(const std::string& prompt, int min = 1, int max = 100) {
     int value;
     while (true) {
@@ -73,7 +444,7 @@ double getGrade(const std::string& prompt, double min = 0.0, double max = 100.0)
     }
 }
 
-void inputStudents(std::vector<Student>& students) {
+void inputStudents(GradeBook& book) {
     int n = getInt("How many students to enter? ", 1, 1000);
 
     for (int i = 0; i < n; ++i) {
@@ -89,66 +460,242 @@ void inputStudents(std::vector<Student>& students) {
             s.grades.push_back(grade);
         }
 
-        students.push_back(s);
+        // Ranked on insertion; no re-sort of the class needed
+        book.addStudent(std::move(s));
+    }
+}
+
+void addGradeToStudent(GradeBook& book) {
+    if (book.empty()) {
+        std::cout << "No student data to edit.\n";
+        return;
+    }
+
+    std::cout << "Enter student name: ";
+    std::string name;
+    std::getline(std::cin, name);
+    size_t id = book.find(name);
+    if (id == book.size()) {
+        std::cout << "No student named " << name << ".\n";
+        return;
     }
 
-    // Sort descending by average after input
-    std::sort(students.begin(), students.end(), [](const Student& a, const Student& b) {
-        return a.average() > b.average();
-    });
+    book.addGrade(id, getGrade("Enter grade: "));
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << name << " now has Average: " << book.average(id)
+              << ", Median: " << book.median(id)
+              << ", Std Dev: " << book.stddev(id)
+              << ", Rank: " << book.rank(id) << " of " << book.size() << "\n";
 }
 
-void printReport(const std::vector<Student>& students) {
-    if (students.empty()) {
+void printReport(const GradeBook& book) {
+    if (book.empty()) {
         std::cout << "No student data to display.\n";
         return;
     }
 
-    double highestAvg = -1;
-    double lowestAvg = 101;
-    std::string topStudent, bottomStudent;
-
     std::cout << "\nStudent Grade Report:\n";
     std::cout << std::fixed << std::setprecision(2);
 
-    for (const auto& s : students) {
-        double avg = s.average();
-        double med = median(s.grades);
-        double sd = stddev(s.grades);
-        std::cout << "Name: " << s.name
-                  << ", Average: " << avg
-                  << ", Median: " << med
-                  << ", Std Dev: " << sd << "\n";
+    // Listed in rank order straight from the cached stats
+    std::vector<size_t> order = book.ranked(book.size(), true);
+    for (size_t id : order) {
+        std::cout << "Name: " << book.students()[id].name
+                  << ", Average: " << book.average(id)
+                  << ", Median: " << book.median(id)
+                  << ", Std Dev: " << book.stddev(id) << "\n";
+    }
+
+    // Ties for lowest report the first student listed, as the full scan did
+    size_t top = order.front();
+    size_t last = order.size() - 1;
+    while (last > 0 && book.average(order[last - 1]) == book.average(order.back())) --last;
+    size_t bottom = order[last];
+    std::cout << "\nHighest Average: " << book.average(top) << " by " << book.students()[top].name << "\n";
+    std::cout << "Lowest Average: " << book.average(bottom) << " by " << book.students()[bottom].name << "\n";
+}
 
-        if (avg > highestAvg) {
-            highestAvg = avg;
-            topStudent = s.name;
+void printRankedReport(const GradeBook& book) {
+    if (book.empty()) {
+        std::cout << "No student data to display.\n";
+        return;
+    }
+
+    int k = getInt("How many students to show? ", 1, 1000000);
+    int which = getInt("1. Highest averages\n2. Lowest averages\nChoose: ", 1, 2);
+    bool highest = (which == 1);
+
+    std::vector<size_t> ranked = book.ranked(k, highest);
+    std::cout << "\n" << (highest ? "Top " : "Bottom ") << ranked.size() << " by average:\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        std::cout << i + 1 << ". " << book.students()[ranked[i]].name
+                  << ", Average: " << book.average(ranked[i]) << "\n";
+    }
+}
+
+enum class SyncPolicy {
+    None,   // rely on the page cache; rename still never exposes a partial file
+    Fsync,  // fsync the data and the directory before reporting success
+    Direct  // O_DIRECT for full blocks, then fsync
+};
+
+// Formats into one large reusable buffer and flushes it with big write()
+// calls. Output goes to "<file>.tmp" and is renamed over the target only when
+// commit() succeeds, so a crash mid-save never truncates the previous file.
+class BufferedFileWriter {
+public:
+    static constexpr size_t blockSize = 4096;
+
+    explicit BufferedFileWriter(size_t capacity = 1 << 20)
+        : capacity((capacity + blockSize - 1) / blockSize * blockSize) {
+        buffer = static_cast<char*>(std::aligned_alloc(blockSize, this->capacity));
+    }
+    BufferedFileWriter(const BufferedFileWriter&) = delete;
+    BufferedFileWriter& operator=(const BufferedFileWriter&) = delete;
+    ~BufferedFileWriter() {
+        abort();
+        std::free(buffer);
+    }
+
+    bool open(const std::string& filename, SyncPolicy syncPolicy = SyncPolicy::None) {
+        abort();
+        path = filename;
+        tmpPath = filename + ".tmp";
+        policy = syncPolicy;
+        used = 0;
+        failed = (buffer == nullptr);
+
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        if (policy == SyncPolicy::Direct) {
+            fd = ::open(tmpPath.c_str(), flags | O_DIRECT, 0644);
+            // Some filesystems (tmpfs) reject O_DIRECT; fall back to buffered I/O.
+            if (fd < 0 && errno == EINVAL) fd = ::open(tmpPath.c_str(), flags, 0644);
+        } else {
+            fd = ::open(tmpPath.c_str(), flags, 0644);
+        }
+        return fd >= 0 && !failed;
+    }
+
+    void append(std::string_view text) {
+        while (!text.empty()) {
+            if (used == capacity && !flush(false)) return;
+            size_t n = std::min(text.size(), capacity - used);
+            std::memcpy(buffer + used, text.data(), n);
+            used += n;
+            text.remove_prefix(n);
         }
-        if (avg < lowestAvg) {
-            lowestAvg = avg;
-            bottomStudent = s.name;
+    }
+
+    void append(char c) {
+        if (used == capacity && !flush(false)) return;
+        buffer[used++] = c;
+    }
+
+    void append(uint64_t value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof digits, value);
+        append(std::string_view(digits, result.ptr - digits));
+    }
+
+    // Shortest representation that parses back to exactly the same double.
+    void append(double value) {
+        char digits[32];
+        auto result = std::to_chars(digits, digits + sizeof digits, value);
+        append(std::string_view(digits, result.ptr - digits));
+    }
+
+    bool commit() {
+        if (fd < 0) return false;
+        bool ok = flush(true);
+        if (ok && policy != SyncPolicy::None) ok = (fsync(fd) == 0);
+        ok = (::close(fd) == 0) && ok;
+        fd = -1;
+        if (ok) ok = (std::rename(tmpPath.c_str(), path.c_str()) == 0);
+        if (ok && policy != SyncPolicy::None) syncDirectory();
+        if (!ok) ::unlink(tmpPath.c_str());
+        return ok;
+    }
+
+    // Drops an uncommitted file, leaving any previous target untouched.
+    void abort() {
+        if (fd < 0) return;
+        ::close(fd);
+        ::unlink(tmpPath.c_str());
+        fd = -1;
+    }
+
+private:
+    bool writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<size_t>(n);
         }
+        return true;
     }
 
-    std::cout << "\nHighest Average: " << highestAvg << " by " << topStudent << "\n";
-    std::cout << "Lowest Average: " << lowestAvg << " by " << bottomStudent << "\n";
-}
+    bool flush(bool final) {
+        if (failed) return false;
+        size_t aligned = used;
+        if (final && policy == SyncPolicy::Direct) {
+            // O_DIRECT needs whole blocks; the tail goes through the page cache.
+            aligned = used / blockSize * blockSize;
+            if (!writeAll(buffer, aligned)) failed = true;
+            int flags = fcntl(fd, F_GETFL);
+            if (!failed && flags != -1) fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+            if (!failed && !writeAll(buffer + aligned, used - aligned)) failed = true;
+        } else if (!writeAll(buffer, used)) {
+            failed = true;
+        }
+        used = 0;
+        return !failed;
+    }
 
-bool saveToFile(const std::string& filename, const std::vector<Student>& students) {
-    std::ofstream file(filename);
-    if (!file) {
+    void syncDirectory() {
+        size_t slash = path.find_last_of('/');
+        std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+        int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dirFd >= 0) {
+            fsync(dirFd);
+            ::close(dirFd);
+        }
+    }
+
+    char* buffer = nullptr;
+    size_t capacity;
+    size_t used = 0;
+    int fd = -1;
+    bool failed = false;
+    SyncPolicy policy = SyncPolicy::None;
+    std::string path;
+    std::string tmpPath;
+};
+
+bool saveToFile(const std::string& filename, const std::vector<Student>& students,
+                SyncPolicy policy = SyncPolicy::None) {
+    // Reused across saves so repeated exports do not reallocate the buffer.
+    static BufferedFileWriter writer;
+    if (!writer.open(filename, policy)) {
         std::cerr << "Error: Could not open file to write.\n";
         return false;
     }
 
     for (const auto& s : students) {
-        file << s.name;
+        writer.append(s.name);
         for (double grade : s.grades) {
-            file << "," << grade;
+            writer.append(',');
+            writer.append(grade);
         }
-        file << "\n";
+        writer.append('\n');
     }
 
+    if (!writer.commit()) {
+        std::cerr << "Error: Could not write " << filename << ".\n";
+        return false;
+    }
     return true;
 }
 
@@ -188,9 +735,209 @@ bool loadFromFile(const std::string& filename, std::vector<Student>& students) {
     }
 
     // Sort descending by average after loading
-    std::sort(students.begin(), students.end(), [](const Student& a, const Student& b) {
-        return a.average() > b.average();
-    });
+    sortByAverage(students);
+
+    return true;
+}
+
+// Binary snapshot layout (little-endian, every section 8-byte aligned):
+//   SnapshotHeader
+//   uint64_t nameOffsets[studentCount + 1]   byte offsets into the name table
+//   uint64_t gradeOffsets[studentCount + 1]  element offsets into the grade array
+//   double   grades[gradeCount]
+//   char     names[nameBytes]
+// Loading maps the file and points into it, so it costs O(1) until a student
+// is actually read.
+constexpr char snapshotMagic[8] = { 'S', 'G', 'M', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t snapshotVersion = 1;
+constexpr bool hostIsLittleEndian = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t studentCount;
+    uint64_t gradeCount;
+    uint64_t nameBytes;
+    uint64_t fileSize;
+};
+static_assert(sizeof(SnapshotHeader) == 48, "snapshot header must stay 48 bytes");
+
+class StudentSnapshot {
+public:
+    StudentSnapshot() = default;
+    StudentSnapshot(const StudentSnapshot&) = delete;
+    StudentSnapshot& operator=(const StudentSnapshot&) = delete;
+    ~StudentSnapshot() { close(); }
+
+    bool open(const std::string& filename) {
+        close();
+        if (!hostIsLittleEndian) {
+            std::cerr << "Error: Snapshots can only be mapped on little-endian hosts.\n";
+            return false;
+        }
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open snapshot to read.\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+            std::cerr << "Error: Snapshot file is truncated.\n";
+            ::close(fd);
+            return false;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Error: Could not map snapshot.\n";
+            return false;
+        }
+        mapped = static_cast<const char*>(mapping);
+        mappedSize = size;
+
+        const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(mapped);
+        if (std::memcmp(header->magic, snapshotMagic, sizeof snapshotMagic) != 0 ||
+            header->version != snapshotVersion ||
+            header->headerSize != sizeof(SnapshotHeader) ||
+            header->fileSize != size ||
+            header->studentCount >= size / (2 * sizeof(uint64_t)) ||
+            header->gradeCount > size / sizeof(double) ||
+            header->nameBytes > size) {
+            std::cerr << "Error: Not a valid student snapshot.\n";
+            close();
+            return false;
+        }
+
+        // Pointer fixup: each section starts right after the previous one.
+        uint64_t offsetsBytes = (header->studentCount + 1) * sizeof(uint64_t);
+        uint64_t expected = sizeof(SnapshotHeader) + 2 * offsetsBytes +
+                            header->gradeCount * sizeof(double) + header->nameBytes;
+        if (expected != size) {
+            std::cerr << "Error: Snapshot sections do not match the file size.\n";
+            close();
+            return false;
+        }
+        const char* cursor = mapped + sizeof(SnapshotHeader);
+        nameOffsets = reinterpret_cast<const uint64_t*>(cursor);
+        cursor += offsetsBytes;
+        gradeOffsets = reinterpret_cast<const uint64_t*>(cursor);
+        cursor += offsetsBytes;
+        gradeData = reinterpret_cast<const double*>(cursor);
+        cursor += header->gradeCount * sizeof(double);
+        names = cursor;
+        count = header->studentCount;
+        gradeTotal = header->gradeCount;
+        nameTotal = header->nameBytes;
+        return true;
+    }
+
+    void close() {
+        if (mapped) munmap(const_cast<char*>(mapped), mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+
+    std::string_view name(size_t i) const {
+        uint64_t begin = nameOffsets[i], end = nameOffsets[i + 1];
+        if (begin > end || end > nameTotal) return {};
+        return std::string_view(names + begin, end - begin);
+    }
+
+    // Grades of student i as a pointer into the mapping; count is set to 0 for
+    // corrupt offsets.
+    const double* grades(size_t i, size_t& gradeCount) const {
+        uint64_t begin = gradeOffsets[i], end = gradeOffsets[i + 1];
+        if (begin > end || end > gradeTotal) {
+            gradeCount = 0;
+            return gradeData;
+        }
+        gradeCount = end - begin;
+        return gradeData + begin;
+    }
+
+private:
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    size_t count = 0;
+    uint64_t gradeTotal = 0;
+    uint64_t nameTotal = 0;
+    const uint64_t* nameOffsets = nullptr;
+    const uint64_t* gradeOffsets = nullptr;
+    const double* gradeData = nullptr;
+    const char* names = nullptr;
+};
+
+bool saveSnapshot(const std::string& filename, const std::vector<Student>& students,
+                  SyncPolicy policy = SyncPolicy::None) {
+    if (!hostIsLittleEndian) {
+        std::cerr << "Error: Snapshots can only be written on little-endian hosts.\n";
+        return false;
+    }
+
+    std::vector<uint64_t> nameOffsets(students.size() + 1);
+    std::vector<uint64_t> gradeOffsets(students.size() + 1);
+    for (size_t i = 0; i < students.size(); ++i) {
+        nameOffsets[i + 1] = nameOffsets[i] + students[i].name.size();
+        gradeOffsets[i + 1] = gradeOffsets[i] + students[i].grades.size();
+    }
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, snapshotMagic, sizeof snapshotMagic);
+    header.version = snapshotVersion;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.studentCount = students.size();
+    header.gradeCount = gradeOffsets.back();
+    header.nameBytes = nameOffsets.back();
+    header.fileSize = sizeof(SnapshotHeader) + 2 * nameOffsets.size() * sizeof(uint64_t) +
+                      header.gradeCount * sizeof(double) + header.nameBytes;
+
+    static BufferedFileWriter writer;
+    if (!writer.open(filename, policy)) {
+        std::cerr << "Error: Could not open snapshot to write.\n";
+        return false;
+    }
+    auto appendBytes = [](const void* data, size_t size) {
+        writer.append(std::string_view(static_cast<const char*>(data), size));
+    };
+    appendBytes(&header, sizeof header);
+    appendBytes(nameOffsets.data(), nameOffsets.size() * sizeof(uint64_t));
+    appendBytes(gradeOffsets.data(), gradeOffsets.size() * sizeof(uint64_t));
+    for (const auto& s : students) {
+        appendBytes(s.grades.data(), s.grades.size() * sizeof(double));
+    }
+    for (const auto& s : students) {
+        writer.append(s.name);
+    }
+
+    if (!writer.commit()) {
+        std::cerr << "Error: Could not write " << filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Replaces the book's students with a snapshot's, in the order they were
+// saved. Names and grades are read straight from the mapping into the book,
+// so each grade is copied once, into the editable roster, with its stats
+// worked out on the way. The book is left alone if the snapshot cannot be
+// opened.
+bool loadFromSnapshot(const std::string& filename, GradeBook& book) {
+    StudentSnapshot snapshot;
+    if (!snapshot.open(filename)) return false;
+
+    book.clear();
+    book.reserve(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        size_t gradeCount;
+        const double* grades = snapshot.grades(i, gradeCount);
+        book.addStudent(std::string(snapshot.name(i)), grades, gradeCount);
+    }
 
     return true;
 }
@@ -201,12 +948,417 @@ void showMenu() {
     std::cout << "2. Print report\n";
     std::cout << "3. Save to file\n";
     std::cout << "4. Load from file\n";
-    std::cout << "5. Exit\n";
+    std::cout << "5. Top/bottom students\n";
+    std::cout << "6. Save snapshot\n";
+    std::cout << "7. Load snapshot\n";
+    std::cout << "8. Add grade to student\n";
+    std::cout << "9. Exit\n";
     std::cout << "Enter choice: ";
 }
 
-int main() {
-    std::vector<Student> students;
+// ---------------------------------------------------------------------------
+// Batch mode: grades --in students.csv --report out.json [--top N]
+// Runs without prompts and reports how long each phase took.
+// ---------------------------------------------------------------------------
+
+// Flat columns parsed from CSV, laid out like a snapshot so both inputs share
+// the same stats code.
+struct StudentColumns {
+    std::vector<uint64_t> nameOffsets{ 0 };
+    std::vector<uint64_t> gradeOffsets{ 0 };
+    std::vector<double> gradeData;
+    std::string names;
+
+    size_t size() const { return nameOffsets.size() - 1; }
+
+    std::string_view name(size_t i) const {
+        return std::string_view(names).substr(nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+    }
+
+    const double* grades(size_t i, size_t& gradeCount) const {
+        gradeCount = gradeOffsets[i + 1] - gradeOffsets[i];
+        return gradeData.data() + gradeOffsets[i];
+    }
+};
+
+// Parses one "name,grade,grade,..." line. Malformed lines are rolled back and
+// reported as false so the caller can count them.
+bool parseCsvLine(const char* first, const char* last, StudentColumns& out) {
+    if (last > first && last[-1] == '\r') --last;
+    const char* comma = static_cast<const char*>(std::memchr(first, ',', last - first));
+    if (!comma) return false;
+
+    size_t gradeStart = out.gradeData.size();
+    const char* pos = comma + 1;
+    while (pos < last) {
+        double grade;
+        auto result = std::from_chars(pos, last, grade);
+        if (result.ec != std::errc() || !std::isfinite(grade) ||
+            (result.ptr != last && *result.ptr != ',')) {
+            out.gradeData.resize(gradeStart);
+            return false;
+        }
+        out.gradeData.push_back(grade);
+        pos = (result.ptr == last) ? last : result.ptr + 1;
+    }
+
+    out.names.append(first, comma - first);
+    out.nameOffsets.push_back(out.names.size());
+    out.gradeOffsets.push_back(out.gradeData.size());
+    return true;
+}
+
+// Streams the file through a fixed read buffer; only the parsed columns grow.
+bool parseCsvColumns(const std::string& filename, StudentColumns& out, uint64_t& bytesRead, uint64_t& skipped) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open " << filename << " to read.\n";
+        return false;
+    }
+
+    std::vector<char> chunk(1 << 20);
+    size_t carry = 0;
+    bytesRead = 0;
+    skipped = 0;
+    while (true) {
+        ssize_t n = ::read(fd, chunk.data() + carry, chunk.size() - carry);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            std::cerr << "Error: Failed reading " << filename << ".\n";
+            ::close(fd);
+            return false;
+        }
+        bytesRead += static_cast<uint64_t>(n);
+        bool eof = (n == 0);
+
+        const char* line = chunk.data();
+        const char* end = chunk.data() + carry + n;
+        while (line < end) {
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            if (!newline && !eof) break;
+            const char* lineEnd = newline ? newline : end;
+            if (lineEnd != line && !parseCsvLine(line, lineEnd, out)) ++skipped;
+            line = newline ? newline + 1 : end;
+        }
+
+        carry = end - line;
+        std::memmove(chunk.data(), line, carry);
+        if (eof) break;
+        if (carry == chunk.size()) chunk.resize(chunk.size() * 2); // line longer than the buffer
+    }
+
+    ::close(fd);
+    return true;
+}
+
+struct StudentStats {
+    double average;
+    double median;
+    double stddev;
+};
+
+// Same definitions as Student::average, median() and stddev(), computed
+// straight from the flat grade arrays.
+template <typename Source>
+std::vector<StudentStats> computeStats(const Source& source) {
+    std::vector<StudentStats> stats(source.size());
+    std::vector<double> scratch;
+    for (size_t i = 0; i < source.size(); ++i) {
+        size_t n;
+        const double* g = source.grades(i, n);
+        if (n == 0) {
+            stats[i] = { 0.0, 0.0, 0.0 };
+            continue;
+        }
+
+        double sum = 0;
+        for (size_t j = 0; j < n; ++j) sum += g[j];
+        double avg = sum / n;
+
+        double variance = 0;
+        for (size_t j = 0; j < n; ++j) variance += (g[j] - avg) * (g[j] - avg);
+        double sd = (n < 2) ? 0.0 : std::sqrt(variance / (n - 1));
+
+        scratch.assign(g, g + n);
+        auto mid = scratch.begin() + n / 2;
+        std::nth_element(scratch.begin(), mid, scratch.end());
+        double med = *mid;
+        if (n % 2 == 0) med = (*std::max_element(scratch.begin(), mid) + med) / 2.0;
+
+        stats[i] = { avg, med, sd };
+    }
+    return stats;
+}
+
+void appendJsonString(BufferedFileWriter& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out.append('"');
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c == '"' || c == '\\') {
+            out.append('\\');
+            out.append(ch);
+        } else if (c < 0x20) {
+            char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            out.append(std::string_view(escaped, sizeof escaped));
+        } else {
+            out.append(ch);
+        }
+    }
+    out.append('"');
+}
+
+struct PhaseTiming {
+    const char* name;
+    double seconds;
+    uint64_t items;
+    uint64_t bytes;
+};
+
+void printTimings(const std::vector<PhaseTiming>& timings) {
+    std::cerr << std::fixed << std::setprecision(2);
+    std::cerr << "phase           ms        items/s         MB/s\n";
+    for (const auto& t : timings) {
+        double seconds = std::max(t.seconds, 1e-9);
+        std::cerr << std::left << std::setw(7) << t.name << std::right
+                  << std::setw(12) << t.seconds * 1e3
+                  << std::setw(15) << t.items / seconds
+                  << std::setw(13) << t.bytes / seconds / 1e6 << "\n";
+    }
+}
+
+template <typename Source>
+void writeRow(BufferedFileWriter& out, const Source& source, const std::vector<StudentStats>& stats,
+              size_t index, uint64_t rank, bool json) {
+    const StudentStats& st = stats[index];
+    if (json) {
+        out.append("{\"rank\":");
+        out.append(rank);
+        out.append(",\"name\":");
+        appendJsonString(out, source.name(index));
+        out.append(",\"average\":");
+        out.append(st.average);
+        out.append(",\"median\":");
+        out.append(st.median);
+        out.append(",\"stddev\":");
+        out.append(st.stddev);
+        out.append('}');
+    } else {
+        out.append(rank);
+        out.append(',');
+        out.append(source.name(index));
+        out.append(',');
+        out.append(st.average);
+        out.append(',');
+        out.append(st.median);
+        out.append(',');
+        out.append(st.stddev);
+        out.append('\n');
+    }
+}
+
+struct BatchOptions {
+    std::string input;
+    std::string report;
+    bool json = true;
+    bool all = false;
+    size_t top = 10;
+    SyncPolicy sync = SyncPolicy::None;
+};
+
+template <typename Source>
+int runReport(const Source& source, const BatchOptions& options, std::vector<PhaseTiming>& timings) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double>(b - a).count();
+    };
+
+    auto t0 = Clock::now();
+    std::vector<StudentStats> stats = computeStats(source);
+    double classSum = 0;
+    uint64_t gradeTotal = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        size_t n;
+        source.grades(i, n);
+        classSum += stats[i].average;
+        gradeTotal += n;
+    }
+    auto t1 = Clock::now();
+    timings.push_back({ "stats", seconds(t0, t1), stats.size(), gradeTotal * sizeof(double) });
+
+    // Full ranking only when every row is requested; otherwise two bounded heaps.
+    auto averageAt = [&](size_t i) { return stats[i].average; };
+    std::vector<size_t> order, top, bottom;
+    if (options.all) {
+        std::vector<SortKey> keys(stats.size());
+        for (size_t i = 0; i < stats.size(); ++i) {
+            keys[i] = { ~orderedKey(stats[i].average), static_cast<uint32_t>(i) };
+        }
+        radixSortKeys(keys);
+        order.reserve(keys.size());
+        for (const auto& k : keys) order.push_back(k.index);
+    }
+    top = rankBy(stats.size(), options.top, true, averageAt);
+    bottom = rankBy(stats.size(), options.top, false, averageAt);
+    auto t2 = Clock::now();
+    timings.push_back({ "sort", seconds(t1, t2), stats.size(), 0 });
+
+    static BufferedFileWriter out(8 << 20);
+    if (!out.open(options.report, options.sync)) {
+        std::cerr << "Error: Could not open " << options.report << " to write.\n";
+        return 1;
+    }
+
+    double classAverage = stats.empty() ? 0.0 : classSum / stats.size();
+    if (options.json) {
+        out.append("{\n\"students\":");
+        out.append(static_cast<uint64_t>(stats.size()));
+        out.append(",\n\"grades\":");
+        out.append(gradeTotal);
+        out.append(",\n\"classAverage\":");
+        out.append(classAverage);
+        out.append(",\n\"timings\":{");
+        for (size_t i = 0; i < timings.size(); ++i) {
+            if (i) out.append(',');
+            out.append('"');
+            out.append(timings[i].name);
+            out.append("\":{\"seconds\":");
+            out.append(timings[i].seconds);
+            out.append(",\"items\":");
+            out.append(timings[i].items);
+            out.append(",\"bytes\":");
+            out.append(timings[i].bytes);
+            out.append('}');
+        }
+        out.append("}");
+        auto writeList = [&](const char* key, const std::vector<size_t>& list) {
+            out.append(",\n\"");
+            out.append(key);
+            out.append("\":[");
+            for (size_t i = 0; i < list.size(); ++i) {
+                out.append(i ? ",\n" : "\n");
+                writeRow(out, source, stats, list[i], i + 1, true);
+            }
+            out.append("]");
+        };
+        writeList("top", top);
+        writeList("bottom", bottom);
+        if (options.all) writeList("ranking", order);
+        out.append("\n}\n");
+    } else {
+        out.append("section,rank,name,average,median,stddev\n");
+        auto writeList = [&](const char* section, const std::vector<size_t>& list) {
+            for (size_t i = 0; i < list.size(); ++i) {
+                out.append(section);
+                out.append(',');
+                writeRow(out, source, stats, list[i], i + 1, false);
+            }
+        };
+        writeList("top", top);
+        writeList("bottom", bottom);
+        if (options.all) writeList("ranking", order);
+    }
+
+    if (!out.commit()) {
+        std::cerr << "Error: Could not write " << options.report << ".\n";
+        return 1;
+    }
+    auto t3 = Clock::now();
+    struct stat st;
+    uint64_t written = (stat(options.report.c_str(), &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+    timings.push_back({ "write", seconds(t2, t3), top.size() + bottom.size() + order.size(), written });
+    return 0;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " --in <students.csv|students.snap> --report <out.json|out.csv>\n"
+              << "       [--top N] [--all] [--format json|csv] [--sync none|fsync|direct]\n"
+              << "Without arguments the interactive menu is started.\n";
+}
+
+int runBatch(int argc, char** argv) {
+    BatchOptions options;
+    bool formatGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (arg == "--in") {
+            options.input = value();
+        } else if (arg == "--report") {
+            options.report = value();
+        } else if (arg == "--top") {
+            std::string n = value();
+            auto result = std::from_chars(n.data(), n.data() + n.size(), options.top);
+            if (n.empty() || result.ec != std::errc()) {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else if (arg == "--all") {
+            options.all = true;
+        } else if (arg == "--format") {
+            std::string format = value();
+            if (format != "json" && format != "csv") {
+                printUsage(argv[0]);
+                return 2;
+            }
+            options.json = (format == "json");
+            formatGiven = true;
+        } else if (arg == "--sync") {
+            std::string sync = value();
+            if (sync == "none") options.sync = SyncPolicy::None;
+            else if (sync == "fsync") options.sync = SyncPolicy::Fsync;
+            else if (sync == "direct") options.sync = SyncPolicy::Direct;
+            else {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.input.empty() || options.report.empty()) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (!formatGiven) {
+        size_t dot = options.report.rfind('.');
+        options.json = !(dot != std::string::npos && options.report.substr(dot) == ".csv");
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<PhaseTiming> timings;
+    int status;
+
+    // Snapshots are recognised by their magic and mapped instead of parsed.
+    char magic[sizeof snapshotMagic] = {};
+    std::ifstream probe(options.input, std::ios::binary);
+    probe.read(magic, sizeof magic);
+    probe.close();
+
+    auto t0 = Clock::now();
+    if (std::memcmp(magic, snapshotMagic, sizeof magic) == 0) {
+        StudentSnapshot snapshot;
+        if (!snapshot.open(options.input)) return 1;
+        timings.push_back({ "parse", std::chrono::duration<double>(Clock::now() - t0).count(), snapshot.size(), 0 });
+        status = runReport(snapshot, options, timings);
+    } else {
+        StudentColumns columns;
+        uint64_t bytes, skipped;
+        if (!parseCsvColumns(options.input, columns, bytes, skipped)) return 1;
+        timings.push_back({ "parse", std::chrono::duration<double>(Clock::now() - t0).count(), columns.size(), bytes });
+        if (skipped) std::cerr << "Skipped " << skipped << " malformed line(s).\n";
+        status = runReport(columns, options, timings);
+    }
+
+    if (status == 0) printTimings(timings);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) return runBatch(argc, argv);
+
+    GradeBook book;
 
     bool running = true;
 
@@ -218,22 +1370,41 @@ int main() {
 
         switch (option) {
             case 1:
-                inputStudents(students);
+                inputStudents(book);
                 break;
             case 2:
-                printReport(students);
+                printReport(book);
                 break;
             case 3:
-                if (saveToFile("students.csv", students)) {
+                if (saveToFile("students.csv", book.students(), SyncPolicy::Fsync)) {
                     std::cout << "Data saved successfully to students.csv\n";
                 }
                 break;
-            case 4:
-                if (loadFromFile("students.csv", students)) {
+            case 4: {
+                std::vector<Student> loaded;
+                if (loadFromFile("students.csv", loaded)) {
+                    book.assign(std::move(loaded));
                     std::cout << "Data loaded successfully from students.csv\n";
                 }
                 break;
+            }
             case 5:
+                printRankedReport(book);
+                break;
+            case 6:
+                if (saveSnapshot("students.snap", book.students(), SyncPolicy::Fsync)) {
+                    std::cout << "Snapshot saved successfully to students.snap\n";
+                }
+                break;
+            case 7:
+                if (loadFromSnapshot("students.snap", book)) {
+                    std::cout << "Snapshot loaded successfully from students.snap\n";
+                }
+                break;
+            case 8:
+                addGradeToStudent(book);
+                break;
+            case 9:
                 running = false;
                 break;
             default: